@@ -0,0 +1,1449 @@
+/**
+ * @file main.cpp
+ * @brief main file for benchmarking parts of er text detection
+ * on ICDAR sized images
+ */
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <functional>
+#include <algorithm>
+#include <iterator>
+#include <thread>
+#include <set>
+#include <tuple>
+
+#include <nocrlib/extremal_region.h>
+#include <nocrlib/er_multi_channel.h>
+#include <nocrlib/er_tiled_detection.h>
+#include <nocrlib/er_coarse_to_fine.h>
+#include <nocrlib/component_tree_builder.h>
+#include <nocrlib/union_find_tree_builder.h>
+#include <nocrlib/classifier_wrap.h>
+#include <nocrlib/ocr.h>
+#include <nocrlib/iksvm.h>
+#include <nocrlib/svm_voting.h>
+#include <nocrlib/train_data.h>
+#include <nocrlib/iooper.h>
+#include <nocrlib/utilities.h>
+
+#include <opencv2/highgui/highgui.hpp>
+#include <opencv2/core/core.hpp>
+
+#include <boost/program_options.hpp>
+
+#include <sys/resource.h>
+
+#define SIZE 1024
+
+using namespace std;
+
+typedef std::chrono::steady_clock Clock;
+typedef std::chrono::microseconds Unit;
+
+string er1_conf_file = "../conf/boost_er1stage_handpicked.xml";
+string er2_conf_file = "../conf/scaled_svmEr2_resized.xml";
+string iksvm_conf_file = "../conf/iksvm_hog_ocr.conf";
+string libsvm_conf_file = "";
+string ocr_test_data = "";
+
+string image_list = "";
+string benchmark = "heap";
+int iterations = 5;
+int candidate_budget = 2000;
+
+int parseCmd(int argc, char ** argv)
+{
+    namespace po = boost::program_options;
+    po::variables_map vm;
+    po::options_description desc("Usage");
+    desc.add_options()
+        ("help,h","display help message")
+        ("er1-conf-file", po::value<string>(&er1_conf_file),"path to er 1 stage Boosting conf")
+        ("er2-conf-file", po::value<string>(&er2_conf_file),"path to er 2 stage SVM conf")
+        ("iksvm-conf-file", po::value<string>(&iksvm_conf_file),"path to IKSVM ocr conf of iksvm, voting, quantization and iksvm-workspace benchmark")
+        ("libsvm-conf-file", po::value<string>(&libsvm_conf_file),"path to LibSVM hog ocr conf of voting benchmark")
+        ("ocr-test-data", po::value<string>(&ocr_test_data),"hog descriptors with labels of voting, quantization and iksvm-workspace benchmark")
+        ("test,t", po::value<string>(&image_list),"list of input images")
+        ("benchmark,b", po::value<string>(&benchmark),"benchmark to run: heap, union-find, workspace, build-tree, first-stage, second-stage, second-stage-features, post-processing, polarity, channels, tiled, coarse-to-fine, budget, scale, iksvm, voting, quantization, iksvm-workspace")
+        ("iterations,i", po::value<int>(&iterations),"number of repetitions per image")
+        ("candidate-budget", po::value<int>(&candidate_budget),"candidate budget of budget benchmark");
+
+    try 
+    {
+        po::parsed_options parsed = po::parse_command_line(argc, argv, desc);
+        po::store( parsed , vm ); 
+        po::notify(vm);
+    } 
+    catch ( po::error &e )
+    {
+        std::cerr << "Parsing cmd line error:" << std::endl;
+        std::cerr << e.what() << std::endl;
+
+        return 1;
+    }
+
+    bool needs_images = benchmark != "voting" && benchmark != "quantization" 
+        && benchmark != "iksvm-workspace";
+    if ( vm.count("help") || argc == 1 || ( needs_images && vm.count("test") == 0 ) )
+    {
+        std::cout << desc << std::endl;
+        return 1;
+    }
+
+    return 0;
+}
+
+/**
+ * @brief accumulates time of repeated runs of one benchmarked variant
+ */
+class BenchmarkRecord
+{
+    public:
+        BenchmarkRecord( const std::string &name )
+            : name_(name), total_(0), runs_(0) { }
+
+        template <typename F>
+        void measure( F && functor )
+        {
+            auto begin = Clock::now();
+            functor();
+            auto end = Clock::now();
+            total_ += tC_(begin, end);
+            ++runs_;
+        }
+
+        void print( std::ostream &oss ) const
+        {
+            double mean = runs_ ? (double) total_.count() / runs_ : 0;
+            oss << name_ << ": " << mean / 1000 << " ms per run ("
+                << runs_ << " runs)" << std::endl;
+        }
+
+        void printPerItem( std::ostream &oss, std::size_t items_per_run, 
+                const std::string &item ) const
+        {
+            double mean = runs_ && items_per_run ? (double) total_.count() / runs_ / items_per_run : 0;
+            oss << "    " << mean * 1000 << " ns per " << item << std::endl;
+        }
+
+    private:
+        std::string name_;
+        Unit total_;
+        int runs_;
+        timeCounter<Clock, Unit> tC_;
+};
+
+cv::Mat loadImage( const std::string &file_path, Resizer &resizer )
+{
+    cv::Mat image = cv::imread( file_path, CV_LOAD_IMAGE_COLOR );
+    if ( !image.empty() && image.rows < SIZE && image.cols < SIZE )
+    {
+        image = resizer.resizeKeepAspectRatio(image);
+    }
+    return image;
+}
+
+void setAreaRatios( ERTree &er_tree, const cv::Mat &image )
+{
+    double min_area_ratio, max_area_ratio;
+    std::tie(min_area_ratio, max_area_ratio) =
+        ErLimitSize::getErSizeLimits(image.size());
+
+    er_tree.setMinAreaRatio(min_area_ratio);
+    er_tree.setMaxAreaRatio(max_area_ratio);
+}
+
+void setUpTree( ERTree &er_tree, const cv::Mat &image )
+{
+    setAreaRatios( er_tree, image );
+    er_tree.setImage(image);
+}
+
+template <typename BUILDER>
+void buildBothPolarities( ERTree &er_tree, const cv::Mat &image )
+{
+    setUpTree( er_tree, image );
+
+    BUILDER builder( &er_tree );
+    builder.buildTree();
+    er_tree.deallocateTree();
+
+    er_tree.invertDomain();
+    builder.buildTree();
+    er_tree.deallocateTree();
+}
+
+void buildBothPolarities( ERWorkspace &workspace, const cv::Mat &image )
+{
+    setAreaRatios( workspace.getTree(), image );
+    workspace.setImage( image );
+
+    workspace.buildTree();
+    workspace.getTree().deallocateTree();
+
+    workspace.getTree().invertDomain();
+    workspace.buildTree();
+    workspace.getTree().deallocateTree();
+}
+
+/**
+ * @brief collects first stage features of all nodes of both polarities,
+ * features are sorted, because order of siblings depends on builder
+ */
+template <typename BUILDER>
+std::vector< std::vector<float> > getBothPolaritiesDesc( ERTree &er_tree, const cv::Mat &image )
+{
+    setUpTree( er_tree, image );
+
+    BUILDER builder( &er_tree );
+    builder.buildTree();
+    auto desc = er_tree.getAllFirstStageDesc();
+    er_tree.deallocateTree();
+
+    er_tree.invertDomain();
+    builder.buildTree();
+    auto inverted_desc = er_tree.getAllFirstStageDesc();
+    er_tree.deallocateTree();
+
+    desc.insert( desc.end(), inverted_desc.begin(), inverted_desc.end() );
+    std::sort( desc.begin(), desc.end() );
+    return desc;
+}
+
+/**
+ * @brief compares std::priority_queue based heap with the bitmask 
+ * heap in ComponentTreeBuilder<ERTree>::buildTree
+ */
+void benchmarkHeap( const std::vector<cv::Mat> &images )
+{
+    ERTextDetection detection( er1_conf_file, er2_conf_file );
+    ERTree &er_tree = detection.getTree();
+
+    BenchmarkRecord priority_queue_record("BitmapHeap (priority queue)");
+    BenchmarkRecord bitmask_record("BitmaskHeap (occupancy mask)");
+
+    for ( const cv::Mat &image : images )
+    {
+        for ( int i = 0; i < iterations; ++i )
+        {
+            priority_queue_record.measure( [&] () 
+                    {
+                        buildBothPolarities< ComponentTreeBuilder<ERTree, BitmapHeap> >( er_tree, image );
+                    });
+
+            bitmask_record.measure( [&] () 
+                    {
+                        buildBothPolarities< ComponentTreeBuilder<ERTree, BitmaskHeap> >( er_tree, image );
+                    });
+        }
+    }
+
+    priority_queue_record.print( cout );
+    bitmask_record.print( cout );
+}
+
+/**
+ * @brief compares flooding ComponentTreeBuilder with UnionFindTreeBuilder,
+ * checks that both builders produce the same nodes with the same
+ * first stage features
+ */
+void benchmarkUnionFind( const std::vector<cv::Mat> &images )
+{
+    ERTextDetection detection( er1_conf_file, er2_conf_file );
+    ERTree &er_tree = detection.getTree();
+
+    BenchmarkRecord flooding_record("ComponentTreeBuilder (flooding)");
+    BenchmarkRecord union_find_record("UnionFindTreeBuilder (union find)");
+
+    std::size_t different_images = 0;
+    for ( std::size_t i = 0; i < images.size(); ++i )
+    {
+        const cv::Mat &image = images[i];
+        auto flooding_desc = getBothPolaritiesDesc< ComponentTreeBuilder<ERTree> >( er_tree, image );
+        auto union_find_desc = getBothPolaritiesDesc< UnionFindTreeBuilder<ERTree> >( er_tree, image );
+        if ( flooding_desc != union_find_desc )
+        {
+            std::vector< std::vector<float> > difference;
+            std::set_symmetric_difference( flooding_desc.begin(), flooding_desc.end(),
+                    union_find_desc.begin(), union_find_desc.end(),
+                    std::back_inserter( difference ) );
+
+            cerr << "image " << i << ": " << flooding_desc.size() << " nodes flooding, "
+                << union_find_desc.size() << " nodes union find, "
+                << difference.size() << " different descriptors" << endl;
+            ++different_images;
+        }
+
+        for ( int j = 0; j < iterations; ++j )
+        {
+            flooding_record.measure( [&] () 
+                    {
+                        buildBothPolarities< ComponentTreeBuilder<ERTree> >( er_tree, image );
+                    });
+
+            union_find_record.measure( [&] () 
+                    {
+                        buildBothPolarities< UnionFindTreeBuilder<ERTree> >( er_tree, image );
+                    });
+        }
+    }
+
+    cout << images.size() - different_images << " of " << images.size() 
+        << " images with equivalent trees" << endl;
+    flooding_record.print( cout );
+    union_find_record.print( cout );
+}
+
+/**
+ * @brief compares ERTree and builder created for every image with
+ * ERWorkspace reused for all images, reports buffer allocations per image
+ */
+void benchmarkWorkspace( const std::vector<cv::Mat> &images )
+{
+    ERTextDetection detection( er1_conf_file, er2_conf_file );
+    ERTree &configuration = detection.getTree();
+
+    BenchmarkRecord fresh_record("fresh tree and builder per image");
+    BenchmarkRecord reused_record("reused ERWorkspace");
+
+    ERTree reused_tree;
+    reused_tree.shareConfiguration( configuration );
+    ERWorkspace reused_workspace( &reused_tree );
+
+    std::size_t fresh_images = 0, fresh_allocations = 0;
+    for ( const cv::Mat &image : images )
+    {
+        for ( int i = 0; i < iterations; ++i )
+        {
+            fresh_record.measure( [&] () 
+                    {
+                        ERTree fresh_tree;
+                        fresh_tree.shareConfiguration( configuration );
+                        ERWorkspace fresh_workspace( &fresh_tree );
+                        buildBothPolarities( fresh_workspace, image );
+
+                        fresh_allocations += fresh_workspace.getAllocations();
+                        ++fresh_images;
+                    });
+
+            reused_record.measure( [&] () 
+                    {
+                        buildBothPolarities( reused_workspace, image );
+                    });
+        }
+    }
+
+    fresh_record.print( cout );
+    cout << "    " << ( fresh_images ? (double) fresh_allocations / fresh_images : 0 ) 
+        << " allocations per image" << endl;
+    reused_record.print( cout );
+    cout << "    " << reused_workspace.getAllocationsPerImage() 
+        << " allocations per image" << endl;
+}
+
+/**
+ * @brief measures ComponentTreeBuilder<ERTree>::buildTree alone, buffers 
+ * of the tree are reused, reports reallocations of tree storage per image.
+ * Compare with the same benchmark of older revision to see effect of changes
+ * in region accumulation and merging.
+ */
+void benchmarkBuildTree( const std::vector<cv::Mat> &images )
+{
+    ERTextDetection detection( er1_conf_file, er2_conf_file );
+    ERTree &er_tree = detection.getTree();
+    ComponentTreeBuilder<ERTree> builder( &er_tree );
+
+    BenchmarkRecord build_record("ComponentTreeBuilder<ERTree>::buildTree");
+
+    std::size_t initial_allocations = er_tree.getAllocations();
+    for ( const cv::Mat &image : images )
+    {
+        setUpTree( er_tree, image );
+        for ( int i = 0; i < iterations; ++i )
+        {
+            build_record.measure( [&] () 
+                    {
+                        builder.buildTree();
+                    });
+            er_tree.deallocateTree();
+        }
+    }
+
+    build_record.print( cout );
+    std::size_t runs = images.size() * iterations;
+    cout << "    " << ( runs ? (double) ( er_tree.getAllocations() - initial_allocations ) / runs : 0 )
+        << " tree storage allocations per run" << endl;
+}
+
+/**
+ * @brief compares evaluation of first stage boosting by OpenCV with
+ * flattened trees on first stage features of all nodes of the trees,
+ * checks that both give identical sums
+ */
+void benchmarkFirstStage( const std::vector<cv::Mat> &images )
+{
+    ERTextDetection detection( er1_conf_file, er2_conf_file );
+    ERTree &er_tree = detection.getTree();
+
+    Boost<feature::ERGeom> boost;
+    boost.setReturningSum(true);
+    boost.loadConfiguration( er1_conf_file );
+    FlatBoost flat_boost;
+    if ( !boost.compile( flat_boost ) )
+    {
+        cerr << "first stage configuration can't be flattened" << endl;
+        return;
+    }
+
+    std::vector< std::vector<float> > descriptors;
+    for ( const cv::Mat &image : images )
+    {
+        auto image_desc = getBothPolaritiesDesc< ComponentTreeBuilder<ERTree> >( er_tree, image );
+        descriptors.insert( descriptors.end(), image_desc.begin(), image_desc.end() );
+    }
+
+    std::size_t different_sums = 0;
+    for ( auto &desc : descriptors )
+    {
+        different_sums += boost.predict( cv::Mat(desc) ) != flat_boost.predict( desc.data() );
+    }
+
+    BenchmarkRecord opencv_record("CvBoost::predict");
+    BenchmarkRecord flat_record("FlatBoost::predict");
+
+    // prevents the compiler from removing evaluation
+    volatile float sink = 0;
+    for ( int i = 0; i < iterations; ++i )
+    {
+        opencv_record.measure( [&] () 
+                {
+                    float sum = 0;
+                    for ( auto &desc : descriptors )
+                    {
+                        sum += boost.predict( cv::Mat(desc) );
+                    }
+                    sink = sum;
+                });
+
+        flat_record.measure( [&] () 
+                {
+                    float sum = 0;
+                    for ( auto &desc : descriptors )
+                    {
+                        sum += flat_boost.predict( desc.data() );
+                    }
+                    sink = sum;
+                });
+    }
+
+    cout << descriptors.size() << " regions, " << flat_boost.getTreeCount() << " trees of depth "
+        << flat_boost.getDepth() << ", " << different_sums << " different sums" << endl;
+    opencv_record.print( cout );
+    opencv_record.printPerItem( cout, descriptors.size(), "region" );
+    flat_record.print( cout );
+    flat_record.printPerItem( cout, descriptors.size(), "region" );
+}
+
+/**
+ * @brief compares second stage features computed from binary image 
+ * of component with features computed from runs of region pixels
+ */
+void benchmarkSecondStageFeatures( const std::vector<cv::Mat> &images )
+{
+    ERTextDetection detection( er1_conf_file, er2_conf_file );
+    ERTree &er_tree = detection.getTree();
+    ERFilter2Stage filter2;
+
+    BenchmarkRecord raster_record("binary image features");
+    BenchmarkRecord runs_record("run length features");
+
+    std::size_t region_count = 0, different_features = 0;
+    std::vector<ERRegion *> regions;
+    auto collect = [&regions] ( ERRegion &r ) 
+    {
+        regions.push_back( &r );
+    };
+
+    for ( const cv::Mat &image : images )
+    {
+        setUpTree( er_tree, image );
+        ComponentTreeBuilder<ERTree> builder( &er_tree );
+        for ( int polarity = 0; polarity < 2; ++polarity )
+        {
+            if ( polarity == 1 )
+            {
+                er_tree.invertDomain();
+            }
+
+            builder.buildTree();
+            er_tree.transformExtreme();
+
+            regions.clear();
+            er_tree.processTree( collect );
+            region_count += regions.size();
+            for ( ERRegion *r : regions )
+            {
+                different_features += filter2.getRasterFeatures( *r ) != filter2.getFeatures( *r );
+            }
+
+            for ( int i = 0; i < iterations; ++i )
+            {
+                raster_record.measure( [&] () 
+                        {
+                            for ( ERRegion *r : regions )
+                            {
+                                filter2.getRasterFeatures( *r );
+                            }
+                        });
+
+                runs_record.measure( [&] () 
+                        {
+                            for ( ERRegion *r : regions )
+                            {
+                                filter2.getFeatures( *r );
+                            }
+                        });
+            }
+
+            er_tree.deallocateTree();
+        }
+    }
+
+    cout << region_count << " regions, " << different_features << " with different features" << endl;
+    std::size_t regions_per_run = region_count / std::max<std::size_t>( images.size() * 2, 1 );
+    raster_record.print( cout );
+    raster_record.printPerItem( cout, regions_per_run, "region" );
+    runs_record.print( cout );
+    runs_record.printPerItem( cout, regions_per_run, "region" );
+}
+
+/**
+ * @brief creates image of concentric rectangles, every rectangle is one
+ * gray level darker than the surrounding one, so the component tree 
+ * has depth 255
+ */
+cv::Mat createDeepTreeImage( int size )
+{
+    cv::Mat image( size, size, CV_8UC3, cv::Scalar(255, 255, 255) );
+    int step = std::max( size / 512, 1 );
+    for ( int level = 1; level < 256 && level * step * 2 < size; ++level )
+    {
+        int offset = level * step;
+        cv::Rect rect( offset, offset, size - 2 * offset, size - 2 * offset );
+        image( rect ).setTo( cv::Scalar::all( 255 - level ) );
+    }
+
+    return image;
+}
+
+bool haveSameComponents( const std::vector<Component> &a, const std::vector<Component> &b )
+{
+    if ( a.size() != b.size() )
+    {
+        return false;
+    }
+
+    for ( std::size_t i = 0; i < a.size(); ++i )
+    {
+        if ( a[i].size() != b[i].size() || a[i].getLeft() != b[i].getLeft() 
+                || a[i].getUpper() != b[i].getUpper() || a[i].getRight() != b[i].getRight()
+                || a[i].getLower() != b[i].getLower() )
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/**
+ * @brief compares separate post-processing passes over the tree with
+ * one traversal in ERTree::getLetters, synthetic image with deep tree
+ * is added to input images
+ */
+void benchmarkPostProcessing( std::vector<cv::Mat> images )
+{
+    ERTextDetection detection( er1_conf_file, er2_conf_file );
+    ERTree &er_tree = detection.getTree();
+    images.push_back( createDeepTreeImage( SIZE ) );
+
+    BenchmarkRecord passes_record("separate passes");
+    BenchmarkRecord fused_record("one traversal");
+
+    ComponentTreeBuilder<ERTree> builder( &er_tree );
+    std::size_t different_outputs = 0;
+    for ( const cv::Mat &image : images )
+    {
+        setUpTree( er_tree, image );
+        for ( int polarity = 0; polarity < 2; ++polarity )
+        {
+            if ( polarity == 1 )
+            {
+                er_tree.invertDomain();
+            }
+
+            std::vector<Component> passes_letters, fused_letters;
+            for ( int i = 0; i < iterations; ++i )
+            {
+                builder.buildTree();
+                passes_record.measure( [&] () 
+                        {
+                            er_tree.transformExtreme();
+                            er_tree.transform2StageFiltering();
+                            er_tree.rejectSimilar();
+
+                            ComponentExtractor extractor;
+                            er_tree.processTree( extractor );
+                            passes_letters = extractor.getExtractedComponents();
+                        });
+                er_tree.deallocateTree();
+
+                builder.buildTree();
+                fused_record.measure( [&] () 
+                        {
+                            fused_letters = er_tree.getLetters( false );
+                        });
+                er_tree.deallocateTree();
+            }
+
+            different_outputs += !haveSameComponents( passes_letters, fused_letters );
+        }
+    }
+
+    cout << images.size() * 2 << " trees, " << different_outputs << " with different letters" << endl;
+    passes_record.print( cout );
+    fused_record.print( cout );
+}
+
+/**
+ * @brief compares second stage filtering evaluated by calling thread
+ * with batches evaluated by all hardware threads
+ */
+void benchmarkSecondStage( const std::vector<cv::Mat> &images )
+{
+    ERTextDetection detection( er1_conf_file, er2_conf_file );
+    detection.setParallelPolarity(false);
+    unsigned thread_count = std::max( std::thread::hardware_concurrency(), 1u );
+
+    BenchmarkRecord serial_record("serial second stage");
+    BenchmarkRecord parallel_record("batched second stage (" 
+            + std::to_string( thread_count ) + " threads)");
+
+    for ( const cv::Mat &image : images )
+    {
+        std::size_t serial_count = 0, parallel_count = 0;
+        for ( int i = 0; i < iterations; ++i )
+        {
+            detection.getTree().setSecondStageThreadCount(1);
+            serial_record.measure( [&] () 
+                    {
+                        serial_count = detection.getLetters( image ).size();
+                    });
+
+            detection.getTree().setSecondStageThreadCount( thread_count );
+            parallel_record.measure( [&] () 
+                    {
+                        parallel_count = detection.getLetters( image ).size();
+                    });
+        }
+
+        if ( serial_count != parallel_count )
+        {
+            cerr << "letter count differs: " << serial_count << " serial, "
+                << parallel_count << " batched" << endl;
+        }
+    }
+
+    serial_record.print( cout );
+    parallel_record.print( cout );
+}
+
+/**
+ * @brief compares serial and parallel processing of both 
+ * polarities in ERTextDetection::getLetters
+ */
+void benchmarkPolarity( const std::vector<cv::Mat> &images )
+{
+    ERTextDetection detection( er1_conf_file, er2_conf_file );
+
+    BenchmarkRecord serial_record("serial polarity passes");
+    BenchmarkRecord parallel_record("parallel polarity passes");
+
+    for ( const cv::Mat &image : images )
+    {
+        std::size_t serial_count = 0, parallel_count = 0;
+        for ( int i = 0; i < iterations; ++i )
+        {
+            detection.setParallelPolarity(false);
+            serial_record.measure( [&] () 
+                    {
+                        serial_count = detection.getLetters( image ).size();
+                    });
+
+            detection.setParallelPolarity(true);
+            parallel_record.measure( [&] () 
+                    {
+                        parallel_count = detection.getLetters( image ).size();
+                    });
+        }
+
+        if ( serial_count != parallel_count )
+        {
+            cerr << "letter count differs: " << serial_count << " serial, "
+                << parallel_count << " parallel" << endl;
+        }
+    }
+
+    serial_record.print( cout );
+    parallel_record.print( cout );
+}
+
+/**
+ * @brief compares single channel er detection with detection 
+ * over default set of channels processed in parallel
+ */
+void benchmarkChannels( const std::vector<cv::Mat> &images )
+{
+    ERTextDetection detection( er1_conf_file, er2_conf_file );
+    ERMultiChannelDetection multi_detection( er1_conf_file, er2_conf_file );
+
+    BenchmarkRecord single_record("single channel (gray)");
+    BenchmarkRecord multi_record("multi channel (R, G, B, H, S, gradient)");
+
+    for ( const cv::Mat &image : images )
+    {
+        for ( int i = 0; i < iterations; ++i )
+        {
+            single_record.measure( [&] () 
+                    {
+                        detection.getLetters( image );
+                    });
+
+            multi_record.measure( [&] () 
+                    {
+                        SegmentationPolicy<ERMultiChannelDetection>::extract( &multi_detection, image );
+                    });
+        }
+    }
+
+    single_record.print( cout );
+    multi_record.print( cout );
+}
+
+/**
+ * @brief compares er detection over whole image with detection
+ * over overlapping strips, images are used in original size
+ */
+void benchmarkTiled( const std::vector<std::string> &image_paths )
+{
+    ERTextDetection detection( er1_conf_file, er2_conf_file );
+    ERTiledDetection tiled_detection( er1_conf_file, er2_conf_file );
+    tiled_detection.setMinTiledArea(0);
+
+    BenchmarkRecord whole_record("whole image");
+    BenchmarkRecord tiled_record("tiled image");
+
+    for ( const std::string &image_path : image_paths )
+    {
+        cv::Mat image = cv::imread( image_path, CV_LOAD_IMAGE_COLOR );
+        if ( image.empty() )
+        {
+            continue;
+        }
+
+        std::size_t whole_count = 0, tiled_count = 0;
+        for ( int i = 0; i < iterations; ++i )
+        {
+            whole_record.measure( [&] () 
+                    {
+                        whole_count = detection.getLetters( image ).size();
+                    });
+
+            tiled_record.measure( [&] () 
+                    {
+                        tiled_count = tiled_detection.getLetters( image ).size();
+                    });
+        }
+
+        cout << image_path << ": " << whole_count << " letters whole, " 
+            << tiled_count << " letters tiled" << endl;
+    }
+
+    whole_record.print( cout );
+    tiled_record.print( cout );
+}
+
+/**
+ * @brief compares er detection over whole image with detection inside
+ * regions of interest proposed in downscaled image, letters of whole
+ * image detection found also by coarse to fine detection are counted
+ * as recalled
+ */
+void benchmarkCoarseToFine( const std::vector<std::string> &image_paths, Resizer &resizer )
+{
+    ERTextDetection detection( er1_conf_file, er2_conf_file );
+    ERCoarseToFineDetection coarse_detection( er1_conf_file, er2_conf_file );
+
+    BenchmarkRecord whole_record("whole image");
+    BenchmarkRecord coarse_record("coarse to fine");
+
+    typedef std::tuple<int, int, int, int, int> Key;
+    auto getKey = [] ( const Component &c ) -> Key
+    {
+        return Key( c.getLeft(), c.getUpper(), c.getRight(), c.getLower(), c.size() );
+    };
+
+    std::size_t whole_total = 0, recalled_total = 0;
+    double coverage_total = 0;
+    int image_count = 0;
+    for ( const std::string &image_path : image_paths )
+    {
+        cv::Mat image = loadImage( image_path, resizer );
+        if ( image.empty() )
+        {
+            continue;
+        }
+
+        std::vector<Component> whole_letters, coarse_letters;
+        for ( int i = 0; i < iterations; ++i )
+        {
+            whole_record.measure( [&] () 
+                    {
+                        whole_letters = detection.getLetters( image );
+                    });
+
+            coarse_record.measure( [&] () 
+                    {
+                        coarse_letters = coarse_detection.getLetters( image );
+                    });
+        }
+
+        int covered_area = 0;
+        for ( const cv::Rect &roi : coarse_detection.getRegionsOfInterest( image ) )
+        {
+            covered_area += roi.area();
+        }
+
+        std::set<Key> coarse_keys;
+        for ( const Component &letter : coarse_letters )
+        {
+            coarse_keys.insert( getKey( letter ) );
+        }
+
+        std::size_t recalled = 0;
+        for ( const Component &letter : whole_letters )
+        {
+            recalled += coarse_keys.count( getKey( letter ) );
+        }
+
+        whole_total += whole_letters.size();
+        recalled_total += recalled;
+        coverage_total += (double) covered_area / image.size().area();
+        ++image_count;
+    }
+
+    cout << image_count << " images, mean roi coverage " 
+        << ( image_count ? coverage_total / image_count : 0 ) << ", recall " 
+        << recalled_total << "/" << whole_total << " letters of whole image" << endl;
+    whole_record.print( cout );
+    coarse_record.print( cout );
+}
+
+/**
+ * @brief compares per image latency of letter detection without and with
+ * candidate budget, median and maximum show the tail of pathological scenes
+ */
+void benchmarkBudget( const std::vector<cv::Mat> &images )
+{
+    ERTextDetection unlimited( er1_conf_file, er2_conf_file );
+    ERTextDetection budgeted( er1_conf_file, er2_conf_file );
+    budgeted.getTree().setCandidateBudget( candidate_budget );
+
+    auto measureImages = [] ( ERTextDetection &detection, const std::string &name, 
+            const std::vector<cv::Mat> &images )
+    {
+        timeCounter<Clock, Unit> tC;
+        std::vector<double> latencies;
+        std::size_t letters = 0;
+        for ( const cv::Mat &image : images )
+        {
+            auto begin = Clock::now();
+            for ( int i = 0; i < iterations; ++i )
+            {
+                letters += detection.getLetters( image ).size();
+            }
+            auto end = Clock::now();
+            latencies.push_back( tC(begin, end).count() / 1000.0 / iterations );
+        }
+
+        if ( latencies.empty() )
+        {
+            return;
+        }
+
+        std::sort( latencies.begin(), latencies.end() );
+        cout << name << ": median " << latencies[ latencies.size() / 2 ] 
+            << " ms, max " << latencies.back() << " ms per image, " 
+            << letters / iterations << " letters" << endl;
+    };
+
+    measureImages( unlimited, "unlimited", images );
+    measureImages( budgeted, "budget " + std::to_string( candidate_budget ), images );
+    // every image is processed in two trees, one per polarity
+    cout << "budget triggered in " << budgeted.getBudgetTriggers() << " of " 
+        << 2 * images.size() * iterations << " trees" << endl;
+}
+
+/**
+ * @brief compares er detection in images upscaled to SIZE with detection 
+ * at native resolution, letters of upscaled images mapped back to input 
+ * coordinates, which overlap a native letter by at least half of their 
+ * union, are counted as found at native resolution too
+ */
+void benchmarkScale( const std::vector<std::string> &image_paths, Resizer &resizer )
+{
+    ERTextDetection detection( er1_conf_file, er2_conf_file );
+
+    BenchmarkRecord upscaled_record("upscaled to " + std::to_string( SIZE ));
+    BenchmarkRecord native_record("native resolution");
+
+    std::size_t upscaled_pixels = 0, native_pixels = 0;
+    std::size_t upscaled_total = 0, native_total = 0, matched_total = 0;
+    for ( const std::string &image_path : image_paths )
+    {
+        cv::Mat image = cv::imread( image_path, CV_LOAD_IMAGE_COLOR );
+        if ( image.empty() )
+        {
+            continue;
+        }
+
+        cv::Mat upscaled = image;
+        if ( image.rows < SIZE && image.cols < SIZE )
+        {
+            upscaled = resizer.resizeKeepAspectRatio( image );
+        }
+        double factor = (double) image.cols / upscaled.cols;
+
+        std::vector<Component> upscaled_letters, native_letters;
+        for ( int i = 0; i < iterations; ++i )
+        {
+            upscaled_record.measure( [&] () 
+                    {
+                        upscaled_letters = detection.getLetters( upscaled );
+                    });
+
+            native_record.measure( [&] () 
+                    {
+                        native_letters = detection.getLetters( image );
+                    });
+        }
+
+        for ( const Component &letter : upscaled_letters )
+        {
+            cv::Rect rect = letter.rectangle();
+            cv::Rect mapped( rect.x * factor, rect.y * factor, 
+                    std::max( 1.0, rect.width * factor ), std::max( 1.0, rect.height * factor ) );
+
+            bool matched = std::any_of( native_letters.begin(), native_letters.end(), 
+                    [&mapped] ( const Component &native_letter )
+                    {
+                        cv::Rect native_rect = native_letter.rectangle();
+                        double intersection = ( mapped & native_rect ).area();
+                        return intersection >= 0.5 * ( mapped.area() + native_rect.area() - intersection );
+                    });
+            matched_total += matched;
+        }
+
+        upscaled_pixels += upscaled.size().area();
+        native_pixels += image.size().area();
+        upscaled_total += upscaled_letters.size();
+        native_total += native_letters.size();
+    }
+
+    cout << "pixels " << upscaled_pixels << " upscaled, " << native_pixels << " native" << endl;
+    cout << "letters " << upscaled_total << " upscaled, " << native_total << " native, " 
+        << matched_total << " of upscaled found at native resolution" << endl;
+    upscaled_record.print( cout );
+    native_record.print( cout );
+}
+
+/**
+ * @brief compares decision function evaluators of IKSVM on hog descriptors
+ * of letters found in images, labels are compared with the reference evaluator
+ */
+void benchmarkIKSVM( const std::vector<cv::Mat> &images )
+{
+    ERTextDetection detection( er1_conf_file, er2_conf_file );
+    auto hog = HogFactory().createFeatureExtractor();
+
+    std::vector<double> descriptors;
+    for ( const cv::Mat &image : images )
+    {
+        for ( Component &letter : detection.getLetters( image ) )
+        {
+            auto features = hog->compute( letter );
+            descriptors.insert( descriptors.end(), features.begin(), features.end() );
+        }
+    }
+
+    IKSVM iksvm;
+    iksvm.load( iksvm_conf_file );
+    std::size_t letters = descriptors.size() / FeatureTraits<feature::hogOcr>::features_length;
+    cout << letters << " letters, best evaluator " 
+        << static_cast<int>( IKSVM::getBestEvaluator() ) << endl;
+
+    std::vector<double> reference_labels;
+    const std::vector< std::pair<IKSVM::Evaluator, std::string> > evaluators = {
+        { IKSVM::Evaluator::reference, "reference" },
+        { IKSVM::Evaluator::scalar, "scalar" },
+        { IKSVM::Evaluator::sse2, "sse2" },
+        { IKSVM::Evaluator::avx2, "avx2" } };
+    for ( const auto &evaluator : evaluators )
+    {
+        iksvm.setEvaluator( evaluator.first );
+        if ( iksvm.getEvaluator() != evaluator.first )
+        {
+            cout << evaluator.second << ": not supported" << endl;
+            continue;
+        }
+
+        BenchmarkRecord record( evaluator.second );
+        std::vector<double> labels;
+        for ( int i = 0; i < iterations; ++i )
+        {
+            record.measure( [&] () 
+                    {
+                        labels = iksvm.predictProbabilityMultiple( descriptors ).first;
+                    });
+        }
+
+        if ( reference_labels.empty() )
+        {
+            reference_labels = labels;
+        }
+
+        std::size_t different = 0;
+        for ( std::size_t k = 0; k < labels.size(); ++k )
+        {
+            different += labels[k] != reference_labels[k];
+        }
+
+        record.print( cout );
+        record.printPerItem( cout, letters, "letter" );
+        cout << "    " << different << " labels differ from reference" << endl;
+    }
+}
+
+/**
+ * @brief loads labeled hog descriptors of ocr test data
+ *
+ * @param descriptors descriptors of all samples one after another
+ * @param test_labels one label per row
+ */
+void loadOcrTestData( std::vector<double> &descriptors, cv::Mat &test_labels )
+{
+    const int features_length = FeatureTraits<feature::hogOcr>::features_length;
+    cv::Mat test_data;
+    TrainDataLoader( features_length ).prepareDataForTraining( 
+            ocr_test_data, test_data, test_labels );
+
+    descriptors.clear();
+    descriptors.reserve( test_data.rows * features_length );
+    for ( int i = 0; i < test_data.rows; ++i )
+    {
+        for ( int j = 0; j < features_length; ++j )
+        {
+            descriptors.push_back( test_data.at<float>(i, j) );
+        }
+    }
+    cout << test_data.rows << " test samples" << endl;
+}
+
+/**
+ * @brief compares voting strategies of IKSVM and LibSVM ocr on labeled
+ * hog descriptors, accuracy and agreement with voting of all classifiers 
+ * are reported
+ */
+void benchmarkVoting()
+{
+    const int features_length = FeatureTraits<feature::hogOcr>::features_length;
+    std::vector<double> descriptors;
+    cv::Mat test_labels;
+    loadOcrTestData( descriptors, test_labels );
+    std::size_t samples = test_labels.rows;
+
+    const std::vector< std::pair<SvmVoting, std::string> > votings = {
+        { SvmVoting::all, "all" },
+        { SvmVoting::early_exit, "early exit" },
+        { SvmVoting::dag, "dag" } };
+
+    auto report = [&test_labels] ( const BenchmarkRecord &record, 
+            const std::vector<double> &labels, const std::vector<double> &all_labels )
+    {
+        std::size_t correct = 0, different = 0;
+        for ( std::size_t k = 0; k < labels.size(); ++k )
+        {
+            correct += labels[k] == test_labels.at<float>(k, 0);
+            different += labels[k] != all_labels[k];
+        }
+
+        record.print( cout );
+        record.printPerItem( cout, labels.size(), "sample" );
+        cout << "    accuracy " << (double) correct / labels.size() << ", " 
+            << different << " labels differ from all" << endl;
+    };
+
+    IKSVM iksvm;
+    iksvm.load( iksvm_conf_file );
+    std::vector<double> all_labels;
+    for ( const auto &voting : votings )
+    {
+        BenchmarkRecord record( "iksvm " + voting.second );
+        std::vector<double> labels;
+        for ( int i = 0; i < iterations; ++i )
+        {
+            record.measure( [&] () 
+                    {
+                        labels = iksvm.predictMultiple( descriptors, voting.first );
+                    });
+        }
+
+        if ( voting.first == SvmVoting::all )
+        {
+            all_labels = labels;
+        }
+        report( record, labels, all_labels );
+    }
+
+    if ( libsvm_conf_file.empty() )
+    {
+        return;
+    }
+
+    LibSVM<feature::hogOcr> libsvm;
+    libsvm.loadConfiguration( libsvm_conf_file );
+    for ( const auto &voting : votings )
+    {
+        BenchmarkRecord record( "libsvm " + voting.second );
+        std::vector<double> labels( samples );
+        for ( int i = 0; i < iterations; ++i )
+        {
+            record.measure( [&] () 
+                    {
+                        for ( std::size_t k = 0; k < samples; ++k )
+                        {
+                            auto first = descriptors.begin() + k * features_length;
+                            std::vector<float> sample( first, first + features_length );
+                            labels[k] = libsvm.predict( sample, voting.first );
+                        }
+                    });
+        }
+
+        if ( voting.first == SvmVoting::all )
+        {
+            all_labels = labels;
+        }
+        report( record, labels, all_labels );
+    }
+}
+
+/**
+ * @brief compares float and quantized tables of IKSVM on labeled hog descriptors,
+ * batch and per letter prediction are measured, accuracy and labels differing 
+ * from float tables are reported
+ */
+void benchmarkQuantization()
+{
+    const int features_length = FeatureTraits<feature::hogOcr>::features_length;
+    std::vector<double> descriptors;
+    cv::Mat test_labels;
+    loadOcrTestData( descriptors, test_labels );
+    std::size_t samples = test_labels.rows;
+
+    IKSVM iksvm;
+    iksvm.load( iksvm_conf_file );
+    cout << "evaluator " << static_cast<int>( iksvm.getEvaluator() ) << endl;
+
+    const std::vector< std::pair<IKSVMQuantization, std::string> > quantizations = {
+        { IKSVMQuantization::none, "float" },
+        { IKSVMQuantization::int16, "int16" },
+        { IKSVMQuantization::int8, "int8" } };
+    std::vector<double> float_labels;
+    for ( const auto &quantization : quantizations )
+    {
+        IKSVM quantized = IKSVMConvertor().quantize( iksvm, quantization.first );
+
+        BenchmarkRecord batch_record( quantization.second + " batch" );
+        BenchmarkRecord letter_record( quantization.second + " per letter" );
+        std::vector<double> labels( samples );
+        for ( int i = 0; i < iterations; ++i )
+        {
+            batch_record.measure( [&] () 
+                    {
+                        labels = quantized.predictProbabilityMultiple( descriptors ).first;
+                    });
+
+            // single letters don't reuse tables, so their size matters
+            letter_record.measure( [&] () 
+                    {
+                        for ( std::size_t k = 0; k < samples; ++k )
+                        {
+                            auto first = descriptors.begin() + k * features_length;
+                            std::vector<double> sample( first, first + features_length );
+                            labels[k] = quantized.predictProbability( sample ).first;
+                        }
+                    });
+        }
+
+        if ( float_labels.empty() )
+        {
+            float_labels = labels;
+        }
+
+        std::size_t correct = 0, different = 0;
+        for ( std::size_t k = 0; k < samples; ++k )
+        {
+            correct += labels[k] == test_labels.at<float>(k, 0);
+            different += labels[k] != float_labels[k];
+        }
+
+        batch_record.print( cout );
+        batch_record.printPerItem( cout, samples, "sample" );
+        letter_record.print( cout );
+        letter_record.printPerItem( cout, samples, "sample" );
+        cout << "    accuracy " << (double) correct / samples << ", " 
+            << different << " labels differ from float" << endl;
+    }
+}
+
+/**
+ * @brief compares per letter prediction of IKSVM with temporary buffers 
+ * and with reused IKSVMWorkspace, then one model is shared by all hardware 
+ * threads, every thread with its own workspace
+ */
+void benchmarkIKSVMWorkspace()
+{
+    const int features_length = FeatureTraits<feature::hogOcr>::features_length;
+    std::vector<double> descriptors;
+    cv::Mat test_labels;
+    loadOcrTestData( descriptors, test_labels );
+    std::size_t samples = test_labels.rows;
+
+    std::vector< std::vector<double> > letters( samples );
+    for ( std::size_t k = 0; k < samples; ++k )
+    {
+        auto first = descriptors.begin() + k * features_length;
+        letters[k].assign( first, first + features_length );
+    }
+
+    IKSVM iksvm;
+    iksvm.load( iksvm_conf_file );
+
+    BenchmarkRecord temporary_record( "temporary buffers" );
+    BenchmarkRecord workspace_record( "reused workspace" );
+    IKSVMWorkspace workspace;
+    std::vector<double> probabilities;
+    std::vector<double> labels( samples ), workspace_labels( samples );
+    for ( int i = 0; i < iterations; ++i )
+    {
+        temporary_record.measure( [&] () 
+                {
+                    for ( std::size_t k = 0; k < samples; ++k )
+                    {
+                        labels[k] = iksvm.predictProbability( letters[k] ).first;
+                    }
+                });
+
+        workspace_record.measure( [&] () 
+                {
+                    for ( std::size_t k = 0; k < samples; ++k )
+                    {
+                        workspace_labels[k] = iksvm.predictProbability( letters[k], 
+                                workspace, probabilities );
+                    }
+                });
+    }
+
+    temporary_record.print( cout );
+    temporary_record.printPerItem( cout, samples, "sample" );
+    workspace_record.print( cout );
+    workspace_record.printPerItem( cout, samples, "sample" );
+
+    unsigned thread_count = std::max( std::thread::hardware_concurrency(), 1u );
+    BenchmarkRecord shared_record( "shared model (" 
+            + std::to_string( thread_count ) + " threads)" );
+    std::vector<double> shared_labels( samples );
+    for ( int i = 0; i < iterations; ++i )
+    {
+        shared_record.measure( [&] () 
+                {
+                    std::vector<std::thread> threads;
+                    for ( unsigned t = 0; t < thread_count; ++t )
+                    {
+                        threads.emplace_back( [&, t] () 
+                                {
+                                    IKSVMWorkspace thread_workspace;
+                                    std::vector<double> thread_probabilities;
+                                    for ( std::size_t k = t; k < samples; k += thread_count )
+                                    {
+                                        shared_labels[k] = iksvm.predictProbability( letters[k], 
+                                                thread_workspace, thread_probabilities );
+                                    }
+                                });
+                    }
+
+                    for ( auto &thread : threads )
+                    {
+                        thread.join();
+                    }
+                });
+    }
+
+    std::size_t different = 0;
+    for ( std::size_t k = 0; k < samples; ++k )
+    {
+        different += workspace_labels[k] != labels[k] || shared_labels[k] != labels[k];
+    }
+
+    shared_record.print( cout );
+    shared_record.printPerItem( cout, samples, "sample" );
+    cout << "    " << different << " labels differ from temporary buffers" << endl;
+}
+
+void printPeakMemory( std::ostream &oss )
+{
+    struct rusage usage;
+    if ( getrusage( RUSAGE_SELF, &usage ) == 0 )
+    {
+        // ru_maxrss is in kilobytes on linux
+        oss << "peak RSS: " << usage.ru_maxrss / 1024 << " MB" << std::endl;
+    }
+}
+
+int main( int argc, char **argv )
+{
+    if (parseCmd(argc, argv))
+    {
+        return 1;
+    }
+
+    Resizer resizer;
+    resizer.setSize(SIZE);
+
+    loader ld;
+    std::vector<std::string> image_paths = ld.getFileContent(image_list);
+    if ( benchmark == "tiled" )
+    {
+        benchmarkTiled( image_paths );
+        printPeakMemory( cout );
+        return 0;
+    }
+
+    if ( benchmark == "voting" )
+    {
+        benchmarkVoting();
+        printPeakMemory( cout );
+        return 0;
+    }
+
+    if ( benchmark == "quantization" )
+    {
+        benchmarkQuantization();
+        printPeakMemory( cout );
+        return 0;
+    }
+
+    if ( benchmark == "iksvm-workspace" )
+    {
+        benchmarkIKSVMWorkspace();
+        printPeakMemory( cout );
+        return 0;
+    }
+
+    if ( benchmark == "scale" )
+    {
+        benchmarkScale( image_paths, resizer );
+        printPeakMemory( cout );
+        return 0;
+    }
+
+    if ( benchmark == "coarse-to-fine" )
+    {
+        benchmarkCoarseToFine( image_paths, resizer );
+        printPeakMemory( cout );
+        return 0;
+    }
+
+    std::vector<cv::Mat> images;
+    for ( const string &file_path : image_paths )
+    {
+        cv::Mat image = loadImage( file_path, resizer );
+        if ( image.empty() )
+        {
+            cerr << "cannot load image " << file_path << endl;
+            continue;
+        }
+        images.push_back( image );
+    }
+
+    if ( benchmark == "heap" )
+    {
+        benchmarkHeap( images );
+    }
+    else if ( benchmark == "union-find" )
+    {
+        benchmarkUnionFind( images );
+    }
+    else if ( benchmark == "workspace" )
+    {
+        benchmarkWorkspace( images );
+    }
+    else if ( benchmark == "build-tree" )
+    {
+        benchmarkBuildTree( images );
+    }
+    else if ( benchmark == "first-stage" )
+    {
+        benchmarkFirstStage( images );
+    }
+    else if ( benchmark == "second-stage" )
+    {
+        benchmarkSecondStage( images );
+    }
+    else if ( benchmark == "second-stage-features" )
+    {
+        benchmarkSecondStageFeatures( images );
+    }
+    else if ( benchmark == "post-processing" )
+    {
+        benchmarkPostProcessing( images );
+    }
+    else if ( benchmark == "polarity" )
+    {
+        benchmarkPolarity( images );
+    }
+    else if ( benchmark == "channels" )
+    {
+        benchmarkChannels( images );
+    }
+    else if ( benchmark == "budget" )
+    {
+        benchmarkBudget( images );
+    }
+    else if ( benchmark == "iksvm" )
+    {
+        benchmarkIKSVM( images );
+    }
+    else
+    {
+        cerr << "unknown benchmark " << benchmark << endl;
+        return 1;
+    }
+
+    printPeakMemory( cout );
+
+    return 0;
+}
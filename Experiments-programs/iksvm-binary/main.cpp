@@ -0,0 +1,98 @@
+/**
+ * @file main.cpp
+ * @brief converts IKSVM model from text format to binary format, 
+ * that is mapped to memory by IKSVM::load
+ */
+
+#include <iostream>
+#include <string>
+#include <chrono>
+
+#include <nocrlib/iksvm.h>
+#include <nocrlib/utilities.h>
+
+#include <boost/program_options.hpp>
+
+using namespace std;
+
+typedef std::chrono::steady_clock Clock;
+typedef std::chrono::microseconds Unit;
+
+string input_file = "";
+string output_file = "";
+string quantization = "none";
+
+int parseCmd(int argc, char ** argv)
+{
+    namespace po = boost::program_options;
+    po::variables_map vm;
+    po::options_description desc("Usage");
+    desc.add_options()
+        ("help,h","display help message")
+        ("input,i", po::value<string>(&input_file),"IKSVM model in text format")
+        ("output,o", po::value<string>(&output_file),"path to binary model")
+        ("quantization,q", po::value<string>(&quantization),"tables of binary model: none, int16, int8");
+
+    try 
+    {
+        po::parsed_options parsed = po::parse_command_line(argc, argv, desc);
+        po::store( parsed , vm ); 
+        po::notify(vm);
+    } 
+    catch ( po::error &e )
+    {
+        std::cerr << "Parsing cmd line error:" << std::endl;
+        std::cerr << e.what() << std::endl;
+
+        return 1;
+    }
+
+    bool known_quantization = quantization == "none" || quantization == "int16" 
+        || quantization == "int8";
+    if ( vm.count("help") || vm.count("input") == 0 || vm.count("output") == 0 
+            || !known_quantization )
+    {
+        std::cout << desc << std::endl;
+        return 1;
+    }
+
+    return 0;
+}
+
+int main( int argc, char **argv )
+{
+    if (parseCmd(argc, argv))
+    {
+        return 1;
+    }
+
+    timeCounter<Clock, Unit> tC;
+    try
+    {
+        IKSVM iksvm;
+        auto begin = Clock::now();
+        iksvm.load( input_file );
+        auto end = Clock::now();
+        cout << "loading " << input_file << ": " << tC(begin, end).count() / 1000.0 << " ms" << endl;
+
+        if ( quantization != "none" )
+        {
+            iksvm = IKSVMConvertor().quantize( iksvm, quantization == "int16" 
+                    ? IKSVMQuantization::int16 : IKSVMQuantization::int8 );
+        }
+        iksvm.saveBinary( output_file );
+
+        IKSVM binary_iksvm;
+        begin = Clock::now();
+        binary_iksvm.load( output_file );
+        end = Clock::now();
+        cout << "loading " << output_file << ": " << tC(begin, end).count() / 1000.0 << " ms" << endl;
+    }
+    catch ( std::exception &e )
+    {
+        cerr << e.what() << endl;
+        return 1;
+    }
+
+    return 0;
+}
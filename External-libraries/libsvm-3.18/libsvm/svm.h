@@ -110,6 +110,9 @@ const char * svm_get_type(int i);
 const char * svm_get_kernel_type(int i);
 int get_svm_type_indx(const char * type);
 int get_kernel_type_indx(const char * type);
+double svm_k_function(const struct svm_node *x, const struct svm_node *y, 
+        const struct svm_parameter *param);
+void multiclass_probability_buffers(int k, double **r, double *p, double **Q, double *Qp);
 
 
 
@@ -16,6 +16,7 @@
 #include "exception.h"
 #include "train_data.h"
 #include "assert.h"
+#include "svm_voting.h"
 
 #include <libsvm/svm.h>
 
@@ -139,6 +140,81 @@ class DesionTree
 
 
 
+/**
+ * @brief flattened ensemble of boosted trees, evaluates weighted sum
+ * of decision functions without OpenCV
+ *
+ * Every tree is padded to complete binary tree of the maximal depth,
+ * inner nodes are stored as (feature, threshold) records in breadth first
+ * order and leaves as values. Sample is evaluated by the fixed number of
+ * steps per tree \f$ i = 2i + 1 + (x_f > t) \f$, without tree specific
+ * branches. Trees are summed in the same order and precision as in CvBoost,
+ * so sums are identical. Only trees with ordered splits are supported.
+ */
+class FlatBoost
+{
+    public:
+        FlatBoost() : depth_(0), tree_count_(0) { }
+
+        /**
+         * @brief converts trees of trained \p boost
+         *
+         * @param boost trained boosting classifier
+         * @param max_depth trees deeper than \p max_depth aren't converted
+         *
+         * @return false if \p boost can't be flattened, FlatBoost is empty then
+         */
+        bool compile( CvBoost &boost, int max_depth = 8 );
+
+        /**
+         * @brief returns weighted sum of decision functions
+         *
+         * @param sample array of features, length is given by the model 
+         */
+        float predict( const float *sample ) const
+        {
+            const int inner_count = ( 1 << depth_ ) - 1;
+            const int *vars = vars_.data();
+            const float *thresholds = thresholds_.data();
+            const double *leaves = leaves_.data();
+
+            double sum = 0;
+            for ( int t = 0; t < tree_count_; ++t )
+            {
+                int i = 0;
+                for ( int d = 0; d < depth_; ++d )
+                {
+                    // negated comparison sends NaN right as in CvBoost
+                    i = 2 * i + 1 + !( sample[ vars[i] ] <= thresholds[i] );
+                }
+
+                sum += leaves[ i - inner_count ];
+                vars += inner_count;
+                thresholds += inner_count;
+                leaves += inner_count + 1;
+            }
+
+            return (float) sum;
+        }
+
+        bool empty() const { return tree_count_ == 0; }
+        int getTreeCount() const { return tree_count_; }
+        int getDepth() const { return depth_; }
+
+    private:
+        int depth_;
+        int tree_count_;
+
+        std::vector<int> vars_;
+        std::vector<float> thresholds_;
+        std::vector<double> leaves_;
+
+        static int getDepth( const CvDTreeNode *node );
+        bool flattenNode( const CvDTreeNode *node, const int *var_type, 
+                int index, int depth, int tree );
+        void clear();
+};
+
 /**
  * @brief wrap of opencv boosting class
  *
@@ -225,6 +301,16 @@ class Boost
         {
             sum_ = sum;
         }
+
+        /**
+         * @brief flattens loaded or trained trees to \p flat_boost
+         *
+         * @return false if trees can't be flattened
+         */
+        bool compile( FlatBoost &flat_boost )
+        {
+            return flat_boost.compile( boost_ );
+        }
     private:
         CvBoost boost_;
         bool sum_;
@@ -307,6 +393,22 @@ class LibSVMTrainBridge
 };
 /// @endcond
 
+/**
+ * @brief predicts class of sample by LibSVM model with given voting
+ *
+ * @param model classification model
+ * @param x sample terminated by node with index -1
+ * @param voting strategy of combining one-vs-one classifiers
+ *
+ * @return label of predicted class, the same as svm_predict for 
+ * SvmVoting::all and SvmVoting::early_exit
+ *
+ * Kernel values are computed only for support vectors of classes
+ * in evaluated classifiers. Models other than classification 
+ * are predicted by svm_predict.
+ */
+double svmPredictVoting( const svm_model *model, const svm_node *x, SvmVoting voting );
+
 /**
  * @brief wrap of SVM implementation from LibSVM
  *
@@ -408,6 +510,23 @@ class LibSVM
             return out;
         }
 
+        /**
+         * @brief predicts class for feature vector sample
+         *
+         * @param sample vector of features
+         * @param voting strategy of combining one-vs-one classifiers,
+         * dag and early_exit evaluate only some of them
+         *
+         * @return label of predicted class
+         */
+        float predict(const std::vector<float> &data, SvmVoting voting ) 
+        {
+            NOCR_ASSERT( svm_ != nullptr , "no configuration loaded yet" );
+
+            bridge_.constructSample( data, &nodes_[0]);
+            return svmPredictVoting( svm_, &nodes_[0], voting );
+        }
+
         /**
          * @brief predicts class for feature vector sample
          *
@@ -362,6 +362,16 @@ class Component
 std::vector<cv::Point> getPerimeterPoints
                        ( Component &c, const cv::Size &bounds );
 
+/**
+ * @brief copy of component moved by offset
+ *
+ * @param c component
+ * @param offset added to every point and to bounds of \p c
+ *
+ * @return translated component
+ */
+Component translated( const Component &c, const cv::Point &offset );
+
 
 
 //=====================Component finder ======================
@@ -16,6 +16,9 @@
 #include <stack>
 #include <opencv2/core/core.hpp>
 #include <queue>
+#include <vector>
+#include <algorithm>
+#include <cstdint>
 
 /**
  * @brief policy for algorithm to build the component tree
@@ -23,16 +26,220 @@
  *
  * @tparam E type of class, that implements structural steps of
  * building the tree
+ *
+ * Policy defines type NodeId, handle of node created by class E, 
+ * and static methods init, getLevel( E*, NodeId ) and setRoot.
  */
 template < typename E > 
 struct ComponentTreePolicy;
 
+/**
+ * @brief boundary pixel heap, that keeps one bucket per gray level
+ * and finds the lowest non empty bucket through std::priority_queue
+ *
+ * @tparam T type of stored boundary pixel record
+ *
+ * The priority queue is pushed every time a bucket becomes non empty
+ * and popped every time a bucket becomes empty.
+ */
+template <typename T> class BitmapHeap
+{
+    public:
+        BitmapHeap()
+        {
+            heap_.clear();
+            heap_.resize(256);
+        }
+
+        void setUp(const cv::Mat &image)
+        {
+            std::vector<int> values_occurence = getOccurences(image);
+            heap_.resize(256);
+            for ( int i = 0; i < 256; ++i )
+            {
+                heap_[i].reserve( values_occurence[i] );
+            }
+        }
+
+        ~BitmapHeap() { }
+        const T& top() const
+        {
+            int priority = -priority_heap_.top();
+            return heap_[priority].back();
+        }
+
+        bool empty() const
+        {
+            return priority_heap_.empty();
+        }
+
+        void pop()
+        {
+            int priority = -priority_heap_.top();
+            heap_[priority].pop_back();
+            if ( heap_[priority].empty() )
+            {
+                priority_heap_.pop();
+            }
+        }
+
+        void push( const T &value, int priority )
+        {
+            bool empty = heap_[priority].empty();
+            heap_[priority].push_back(value);
+            if ( empty )
+            {
+                priority_heap_.push( -priority );
+            }
+        }
+
+        /**
+         * @brief total capacity of all buckets
+         */
+        std::size_t getCapacity() const
+        {
+            std::size_t capacity = 0;
+            for ( const auto &bucket : heap_ )
+            {
+                capacity += bucket.capacity();
+            }
+            return capacity;
+        }
+
+    private:
+        std::vector< std::vector< T > > heap_;
+        std::priority_queue<int> priority_heap_;
+
+        std::vector<int> getOccurences( const cv::Mat &image )
+        {
+            std::vector<int> occurences(256,0);
+            std::for_each( image.begin<uchar>(), image.end<uchar>(),
+                    [&occurences] ( int i )
+                    {
+                        occurences[i] += 1;
+                    });
+            return occurences;
+        }
+};
+
+/**
+ * @brief boundary pixel heap, that keeps one bucket per gray level
+ * and tracks non empty buckets in 256 bit occupancy mask
+ *
+ * @tparam T type of stored boundary pixel record
+ *
+ * Lowest non empty gray level is found in constant time by counting
+ * trailing zeros of the first non zero 64 bit word of the mask, so
+ * push and pop don't touch any other structure than the bucket itself.
+ */
+template <typename T> class BitmaskHeap
+{
+    public:
+        BitmaskHeap()
+            : heap_(k_levels)
+        {
+            std::fill( mask_, mask_ + k_words, 0 );
+        }
+
+        void setUp(const cv::Mat &image)
+        {
+            std::vector<int> values_occurence( k_levels, 0 );
+            std::for_each( image.begin<uchar>(), image.end<uchar>(),
+                    [&values_occurence] ( int i )
+                    {
+                        values_occurence[i] += 1;
+                    });
+
+            for ( int i = 0; i < k_levels; ++i )
+            {
+                heap_[i].reserve( values_occurence[i] );
+            }
+        }
+
+        ~BitmaskHeap() { }
+
+        const T& top() const
+        {
+            return heap_[getLowestLevel()].back();
+        }
+
+        bool empty() const
+        {
+            return ( mask_[0] | mask_[1] | mask_[2] | mask_[3] ) == 0;
+        }
+
+        void pop()
+        {
+            int priority = getLowestLevel();
+            heap_[priority].pop_back();
+            if ( heap_[priority].empty() )
+            {
+                mask_[priority >> 6] &= ~( std::uint64_t(1) << ( priority & 63 ) );
+            }
+        }
+
+        void push( const T &value, int priority )
+        {
+            heap_[priority].push_back(value);
+            mask_[priority >> 6] |= std::uint64_t(1) << ( priority & 63 );
+        }
+
+        /**
+         * @brief total capacity of all buckets
+         */
+        std::size_t getCapacity() const
+        {
+            std::size_t capacity = 0;
+            for ( const auto &bucket : heap_ )
+            {
+                capacity += bucket.capacity();
+            }
+            return capacity;
+        }
+
+    private:
+        static const int k_levels = 256;
+        static const int k_words = k_levels / 64;
+
+        std::vector< std::vector< T > > heap_;
+        std::uint64_t mask_[k_words];
+
+        int getLowestLevel() const
+        {
+            for ( int i = 0; i < k_words; ++i )
+            {
+                if ( mask_[i] )
+                {
+                    return ( i << 6 ) + countTrailingZeros( mask_[i] );
+                }
+            }
+            return k_levels;
+        }
+
+        static int countTrailingZeros( std::uint64_t word )
+        {
+#if defined(__GNUC__)
+            return __builtin_ctzll( word );
+#else
+            int count = 0;
+            for ( ; ( word & 1 ) == 0; word >>= 1 )
+            {
+                ++count;
+            }
+            return count;
+#endif
+        }
+};
+
 /**
  * @brief ComponentTreeBuilder encapsulates algorithm proposed by
  * Nisterius and co. for building component tree
  *
  * @tparam E type of class, that implements structural steps of
  * building the tree and from which we get the domain bitmap.
+ * @tparam HEAP type of heap for boundary pixels, BitmaskHeap finds
+ * the lowest gray level in constant time, BitmapHeap uses
+ * std::priority_queue
  *
  * Class E will take care of structural steps of building tree such
  * as connecting children node to the parent node. It also 
@@ -41,7 +248,7 @@ struct ComponentTreePolicy;
  * documentation. ComponentTreeBuilder only specifies the algorithm, or plan 
  * of building the tree.
  */
-template < typename E > 
+template < typename E, template <typename> class HEAP = BitmaskHeap > 
 class ComponentTreeBuilder
 {
     public:
@@ -52,20 +259,31 @@ class ComponentTreeBuilder
          * @param extraction raw pointer to the instance of class Extraction
          */
         ComponentTreeBuilder( E *extraction )
-            : extraction_( extraction )
+            : extraction_( extraction ), allocations_(0)
         {
 
         }
 
         ~ComponentTreeBuilder()
         {
-            while( !stack_.empty() )
-            {
-                NodeType *top = stack_.top();
-                stack_.pop();
-                // delete top;
-                extraction_->destroyNode(top);
-            }
+            releaseStack();
+        }
+
+        ComponentTreeBuilder( const ComponentTreeBuilder &other ) = delete;
+        ComponentTreeBuilder& operator=( const ComponentTreeBuilder &other ) = delete;
+
+        /**
+         * @brief number of growths of builder buffers
+         *
+         * @return count of buildTree calls, in which accessibility mask,
+         * boundary heap or node stack had to grow
+         *
+         * Buffers keep their capacity between calls of buildTree, so builder
+         * reused for images of the same size stops allocating after first image.
+         */
+        std::size_t getAllocations() const
+        {
+            return allocations_;
         }
 
         /**
@@ -78,16 +296,20 @@ class ComponentTreeBuilder
          * Output is root of component tree. ComponentTreeBuilder is not resposible 
          * for deallocating the ComponentTree, that is an user responsibility.
          */
-        typename ComponentTreePolicy<E>::NodeType* buildTree()
+        typename ComponentTreePolicy<E>::NodeId buildTree()
         // void buildTree()
         {
             //assert( image je v GrayScale)
             // step 1 - 2 of algorithm
             // initialization
             cv::Mat domain_bitmap = extraction_->getDomain();
+            std::size_t mask_capacity = accessible_pixels_.capacity();
+            std::size_t heap_capacity = boundary_pixels_.getCapacity();
+            std::size_t stack_capacity = stack_.capacity();
+
             int init_pixel;
             ComponentTreePolicy<E>::init( domain_bitmap, accessible_pixels_, &init_pixel );
-            stack_.push( extraction_->createRootNode());
+            stack_.push_back( extraction_->createRootNode());
             const uchar* image_data = domain_bitmap.data;
             cols_ = domain_bitmap.cols; 
             rows_ = domain_bitmap.rows;
@@ -139,13 +361,19 @@ class ComponentTreeBuilder
                     }
 
                     // add current pixel to component on stack
-                    extraction_->accumulate( stack_.top(), curr_pixel_.code_position);
+                    extraction_->accumulate( stack_.back(), curr_pixel_.code_position);
                     if ( boundary_pixels_.empty() )
                     {
                         // we are done
-                        NodeType* root = stack_.top();
-                        stack_.pop();
+                        NodeId root = stack_.back();
+                        stack_.pop_back();
                         ComponentTreePolicy<E>::setRoot(root, extraction_);
+                        // only the artificial root is left on the stack
+                        releaseStack();
+
+                        allocations_ += ( accessible_pixels_.capacity() > mask_capacity ) 
+                            + ( boundary_pixels_.getCapacity() > heap_capacity )
+                            + ( stack_.capacity() > stack_capacity );
                         return root;
                     }
 
@@ -172,98 +400,31 @@ class ComponentTreeBuilder
         };
 
 
-        template <typename T> class BitmapHeap
-        {
-            public:
-                BitmapHeap() 
-                    // :priority_(256)
-                {
-                    heap_.clear();
-                    heap_.resize(256);
-                }
-
-                void setUp(const cv::Mat &image)
-                {
-                    std::vector<int> values_occurence = getOccurences(image);
-                    heap_.resize(256);
-                    for ( int i = 0; i < 256; ++i )
-                    {
-                        heap_[i].reserve( values_occurence[i] );
-                    }
-                }
-
-                ~BitmapHeap() { }
-                const T& top() const 
-                {
-                    // return heap_[priority_].back();
-                    int priority = -priority_heap_.top();
-                    return heap_[priority].back();
-                }
-
-                bool empty() const
-                {
-                    // return priority_ == 256; 
-                    return priority_heap_.empty();
-                }
-
-                void pop() 
-                {
-                    int priority = -priority_heap_.top();
-                    // heap_[hep].pop_back();
-                    //
-                    // while (  priority_ < 256 && heap_[priority_].empty()  ) 
-                    // {
-                    //     ++priority_;
-                    // }
-                    heap_[priority].pop_back();
-                    if ( heap_[priority].empty() )
-                    {
-                        priority_heap_.pop();
-                    }
-                }
-
-                void push( const T &value, int priority )
-                {
-                    // heap_[priority].push_back(value);
-                    // priority_ = std::min( priority_, priority );
-                    bool empty = heap_[priority].empty();
-                    heap_[priority].push_back(value);
-                    if ( empty )
-                    {
-                        priority_heap_.push( -priority );
-                    }
-                }
-
-                // int priority_;
-                std::vector< std::vector< T > > heap_;
-                std::priority_queue<int> priority_heap_;
-                // std::vector< std::vector<T> > heap_[256];
-                
-                std::vector<int> getOccurences( const cv::Mat &image )
-                {
-                    std::vector<int> occurences(256,0);
-                    std::for_each( image.begin<uchar>(), image.end<uchar>(), 
-                            [&occurences] ( int i ) 
-                            {
-                                occurences[i] += 1;
-                            });
-                    return occurences;
-                }
-        };
-
         //=================== private class members =====================================
 
         E *extraction_;
 
-        typedef typename ComponentTreePolicy<E>::NodeType NodeType;
+        typedef typename ComponentTreePolicy<E>::NodeId NodeId;
 
         std::vector<bool> accessible_pixels_;
-        BitmapHeap<PixelRecord> boundary_pixels_; 
+        HEAP<PixelRecord> boundary_pixels_; 
         int curr_level_;
         PixelRecord curr_pixel_;
-        std::stack< NodeType* > stack_;
+        // vector keeps its capacity between images unlike std::deque
+        std::vector< NodeId > stack_;
 
         int rows_, cols_;
+        std::size_t allocations_;
+
+        void releaseStack()
+        {
+            while( !stack_.empty() )
+            {
+                // delete top;
+                extraction_->destroyNode( stack_.back() );
+                stack_.pop_back();
+            }
+        }
 
         int getNeighbour( const PixelRecord &rec )
         {
@@ -286,8 +447,8 @@ class ComponentTreeBuilder
         void pushRegion( int level, int pixel_code)
         {
             cv::Point pixel = getPoint(pixel_code);
-            NodeType* node = extraction_->createNode(pixel, level);
-            stack_.push( node );
+            NodeId node = extraction_->createNode(pixel, level);
+            stack_.push_back( node );
         }
 
         cv::Point getPoint( int pixel_code )
@@ -300,17 +461,17 @@ class ComponentTreeBuilder
             int top_level;
             do 
             {
-                NodeType *child = stack_.top(); 
-                stack_.pop();
-                top_level = ComponentTreePolicy<E>::getLevel( stack_.top() ); 
+                NodeId child = stack_.back(); 
+                stack_.pop_back();
+                top_level = ComponentTreePolicy<E>::getLevel( extraction_, stack_.back() ); 
                 if ( curr_level_ < top_level ) 
                 {
                     pushRegion( curr_level_, curr_pixel_.code_position );
-                    extraction_->merge( child, stack_.top() ); 
+                    extraction_->merge( child, stack_.back() ); 
                     return;
                 }
 
-                extraction_->merge( child, stack_.top() ); 
+                extraction_->merge( child, stack_.back() ); 
             }
             while( curr_level_ > top_level ); 
         }
@@ -0,0 +1,83 @@
+/**
+ * @file deadline.h
+ * @brief Contains class Deadline, time limit of one recognition, and
+ * structure TruncatedStages, that reports stages cut by the deadline.
+ */
+
+#ifndef NOCRLIB_DEADLINE_H
+#define NOCRLIB_DEADLINE_H
+
+#include <chrono>
+
+/**
+ * @brief point in time, after which long running stages stop
+ * and return results found so far
+ *
+ * Default constructed deadline never expires.
+ */
+class Deadline
+{
+    public:
+        typedef std::chrono::steady_clock Clock;
+
+        /**
+         * @brief deadline, that never expires
+         */
+        Deadline() : unlimited_(true) { }
+
+        /**
+         * @brief deadline at given time point
+         *
+         * @param time_point time of expiration
+         */
+        explicit Deadline( Clock::time_point time_point )
+            : unlimited_(false), time_point_(time_point) { }
+
+        /**
+         * @brief deadline after given time budget from now
+         *
+         * @param budget time budget
+         *
+         * @return deadline expiring at now + \p budget
+         */
+        template <typename Rep, typename Period>
+        static Deadline after( const std::chrono::duration<Rep, Period> &budget )
+        {
+            return Deadline( Clock::now()
+                    + std::chrono::duration_cast<Clock::duration>( budget ) );
+        }
+
+        /**
+         * @brief returns true, if deadline has passed
+         */
+        bool expired() const
+        {
+            return !unlimited_ && Clock::now() >= time_point_;
+        }
+
+        bool isUnlimited() const { return unlimited_; }
+
+    private:
+        bool unlimited_;
+        Clock::time_point time_point_;
+};
+
+/**
+ * @brief stages of text recognition, that were cut by the deadline
+ */
+struct TruncatedStages
+{
+    // only some polarities or parts of image were searched for letters
+    bool extraction = false;
+    // only some letter candidates were translated by ocr
+    bool ocr = false;
+    // only part of dictionary was searched
+    bool word_generation = false;
+
+    bool any() const
+    {
+        return extraction || ocr || word_generation;
+    }
+};
+
+#endif /* deadline.h */
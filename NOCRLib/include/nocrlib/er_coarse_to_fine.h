@@ -0,0 +1,144 @@
+/**
+ * @file er_coarse_to_fine.h
+ * @brief Contains class ERCoarseToFineDetection, that extracts extremal
+ * regions at full resolution only around text proposals found in downscaled
+ * image, and specialized SegmentationPolicy for its integration with class Segment.
+ */
+
+#ifndef NOCRLIB_ER_COARSE_TO_FINE_H
+#define NOCRLIB_ER_COARSE_TO_FINE_H
+
+#include "extremal_region.h"
+#include "segment.h"
+#include "component.h"
+
+#include <opencv2/core/core.hpp>
+
+#include <vector>
+#include <string>
+
+/**
+ * @brief method class for two level er text extraction
+ *
+ * Component tree of downscaled image is filtered by the first stage
+ * of ER only, bounding boxes of remaining regions are text proposals.
+ * Proposals are scaled to the input image, dilated and overlapping ones
+ * are merged into regions of interest. Full resolution extraction
+ * with second stage runs only inside regions of interest, size bounds
+ * of regions are computed for the whole image. If regions of interest
+ * cover too large part of image, the whole image is processed.
+ *
+ * This class isn't copyable and copy-assignable.
+ */
+class ERCoarseToFineDetection
+{
+    public:
+        typedef Component Storage;
+
+        /**
+         * @brief initialize object with configuration files
+         *
+         * @param first_stage_conf configuration file for first stage of ER
+         * @param second_stage_conf configuration file for second stage of ER
+         */
+        ERCoarseToFineDetection( const std::string &first_stage_conf,
+                const std::string &second_stage_conf );
+
+        ERCoarseToFineDetection( const ERCoarseToFineDetection &other ) = delete;
+        ERCoarseToFineDetection& operator=( const ERCoarseToFineDetection &other ) = delete;
+
+        /**
+         * @brief finds letter candidates in regions of interest of image
+         *
+         * @param image input image, CV8UC3 required format
+         *
+         * @return vector of letter candidates in coordinates of \p image
+         */
+        std::vector<Storage> getLetters( const cv::Mat &image );
+
+        /**
+         * @brief finds regions of interest in downscaled image
+         *
+         * @param image input image, CV8UC3 required format
+         *
+         * @return disjoint rectangles in coordinates of \p image
+         */
+        std::vector<cv::Rect> getRegionsOfInterest( const cv::Mat &image );
+
+        /**
+         * @brief set scale of image for proposal pass
+         *
+         * @param scale must be in range (0, 1]
+         */
+        void setCoarseScale( double scale );
+
+        /**
+         * @brief set dilation of proposals
+         *
+         * @param margin_ratio proposal is dilated by \p margin_ratio * its height
+         * on every side
+         * @param min_margin minimal dilation in pixels of input image
+         */
+        void setMargin( double margin_ratio, int min_margin )
+        {
+            margin_ratio_ = margin_ratio;
+            min_margin_ = min_margin;
+        }
+
+        /**
+         * @brief set ratio of image area, that regions of interest can cover,
+         * larger coverage leads to processing of the whole image
+         *
+         * @param max_coverage ratio in range [0, 1]
+         */
+        void setMaxCoverage( double max_coverage )
+        {
+            max_coverage_ = max_coverage;
+        }
+
+        /**
+         * @brief full resolution detection, it holds the configuration
+         *
+         * @return reference to ERTextDetection
+         */
+        ERTextDetection & getDetection()
+        {
+            return detection_;
+        }
+
+        ERTree & getTree()
+        {
+            return detection_.getTree();
+        }
+
+    private:
+        ERTextDetection detection_;
+
+        ERTree coarse_tree_;
+        ERWorkspace coarse_workspace_{ &coarse_tree_ };
+
+        double scale_ = 0.5;
+        double margin_ratio_ = 0.5;
+        int min_margin_ = 8;
+        double max_coverage_ = 0.6;
+
+        cv::Rect toImageRect( const cv::Rect &coarse_rect, const cv::Size &image_size ) const;
+};
+
+/**
+ * @brief Specified policy class SegmentationPolicy for ERCoarseToFineDetection
+ */
+template <>
+class SegmentationPolicy<ERCoarseToFineDetection>
+    : public SegmentationPolicy<ERTextDetection>
+{
+    public:
+        static std::vector<MethodOutput> extract
+            ( ERCoarseToFineDetection * er_detection,
+              const cv::Mat &image )
+        {
+            return er_detection->getLetters(image);
+        }
+};
+
+#endif /* er_coarse_to_fine.h */
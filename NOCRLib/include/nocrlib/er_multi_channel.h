@@ -0,0 +1,135 @@
+/**
+ * @file er_multi_channel.h
+ * @brief Contains class ERMultiChannelDetection, that extracts
+ * extremal regions from several channels of input image in parallel
+ * and specialized SegmentationPolicy for its integration with class Segment.
+ */
+
+#ifndef NOCRLIB_ER_MULTI_CHANNEL_H
+#define NOCRLIB_ER_MULTI_CHANNEL_H
+
+#include "extremal_region.h"
+#include "segment.h"
+#include "component.h"
+
+#include <opencv2/core/core.hpp>
+
+#include <vector>
+#include <memory>
+#include <string>
+
+/**
+ * @brief channels of input image, from which extremal regions
+ * can be extracted
+ */
+enum class ERChannel { gray, red, green, blue, hue, saturation, gradient };
+
+/**
+ * @brief method class for er text extraction from several channels
+ * of input image
+ *
+ * Every channel is processed by its own ERTextDetection sharing classifiers
+ * with the others, channels are processed on separate threads.
+ * This class isn't copyable and copy-assignable.
+ */
+class ERMultiChannelDetection
+{
+    public:
+        typedef Component Storage;
+
+        /**
+         * @brief initialize object with configuration files and
+         * channels to be processed
+         *
+         * @param first_stage_conf configuration file for first stage of ER
+         * @param second_stage_conf configuration file for second stage of ER
+         * @param channels channels of input image, letters are extracted from
+         */
+        ERMultiChannelDetection( const std::string &first_stage_conf,
+                const std::string &second_stage_conf,
+                const std::vector<ERChannel> &channels = getDefaultChannels() );
+
+        ERMultiChannelDetection( const ERMultiChannelDetection &other ) = delete;
+        ERMultiChannelDetection& operator=( const ERMultiChannelDetection &other ) = delete;
+
+        /**
+         * @brief set channels of input image, letters are extracted from
+         *
+         * @param channels channels to be processed
+         */
+        void setChannels( const std::vector<ERChannel> &channels );
+
+        std::vector<ERChannel> getChannels() const { return channels_; }
+
+        /**
+         * @brief finds letter candidates in every channel of image
+         *
+         * @param image input image, CV8UC3 required format
+         *
+         * @return vector of letter candidates for every channel in order
+         * given by getChannels()
+         */
+        std::vector< std::vector<Storage> > getChannelLetters( const cv::Mat &image );
+
+        /**
+         * @brief tree holding the configuration shared by all channels
+         *
+         * @return reference to ERTree
+         */
+        ERTree & getTree()
+        {
+            return detection_.getTree();
+        }
+
+        /**
+         * @brief converts BGR image to required channel
+         *
+         * @param image input image, CV8UC3 required format
+         * @param channel channel to be extracted
+         *
+         * @return single channel image, CV8UC1 format
+         */
+        static cv::Mat extractChannel( const cv::Mat &image, ERChannel channel );
+
+        static std::vector<ERChannel> getDefaultChannels()
+        {
+            return { ERChannel::red, ERChannel::green, ERChannel::blue,
+                ERChannel::hue, ERChannel::saturation, ERChannel::gradient };
+        }
+
+    private:
+        ERTextDetection detection_;
+
+        std::vector<ERChannel> channels_;
+        std::vector< std::unique_ptr<ERTextDetection> > channel_detections_;
+};
+
+/**
+ * @brief Specified policy class SegmentationPolicy for ERMultiChannelDetection,
+ * letters from all channels are merged before non max suppresion
+ */
+template <>
+class SegmentationPolicy<ERMultiChannelDetection>
+    : public SegmentationPolicy<ERTextDetection>
+{
+    public:
+        static std::vector<MethodOutput> extract
+            ( ERMultiChannelDetection * er_detection,
+              const cv::Mat &image )
+        {
+            return merge( er_detection->getChannelLetters(image) );
+        }
+
+        /**
+         * @brief merges letters from all channels, letters with same
+         * bounding box and size found in more channels are kept only once
+         *
+         * @param channel_letters letter candidates of every channel
+         *
+         * @return merged letter candidates
+         */
+        static std::vector<MethodOutput> merge
+            ( const std::vector< std::vector<MethodOutput> > &channel_letters );
+};
+
+#endif /* er_multi_channel.h */
@@ -17,19 +17,128 @@
 #include <queue>
 #include <cstdint>
 #include <bitset>
+#include <vector>
 
 
-struct LinkedPoint 
+/**
+ * @brief pixel lists of all regions in one component tree
+ *
+ * Pixels are identified by code \f$code = y * domain.width + x \f$,
+ * every pixel is linked to the next pixel of its region by 32 bit code,
+ * so one list link costs 4 bytes per pixel of domain. Positions of pixels
+ * are decoded only when region is converted to component.
+ */
+class PixelLinks
 {
-    LinkedPoint()
-        : next_(nullptr), prev_(nullptr), val_(cv::Point(-1,-1)) { } 
+    public:
+        PixelLinks() : cols_(0) { }
+
+        /**
+         * @brief prepares links for domain of given size, 
+         * capacity is reused
+         */
+        void reset( int rows, int cols )
+        {
+            cols_ = cols;
+            next_.resize( rows * cols );
+        }
+
+        void link( std::uint32_t code, std::uint32_t next_code )
+        {
+            next_[code] = next_code;
+        }
+
+        std::uint32_t getNext( std::uint32_t code ) const
+        {
+            return next_[code];
+        }
+
+        cv::Point decode( std::uint32_t code ) const
+        {
+            return cv::Point( code % cols_, code / cols_ );
+        }
 
-    LinkedPoint(cv::Point val)
-        : next_(nullptr), prev_(nullptr), val_(val) { } 
+        std::size_t getCapacity() const
+        {
+            return next_.capacity();
+        }
 
-    LinkedPoint *next_;
-    LinkedPoint *prev_;
-    cv::Point val_;
+    private:
+        int cols_;
+        std::vector<std::uint32_t> next_;
+};
+
+
+/**
+ * @brief storage of horizontal crossings of all regions in one component tree
+ *
+ * Crossings of one region are kept in one block of the arena, blocks
+ * have power of two sizes. Released blocks are linked in free list
+ * of their size and reused by the next allocation of the same size,
+ * link is stored in the first element of released block. Arena
+ * is cleared once per image, capacity is reused.
+ */
+class CrossingArena
+{
+    public:
+        static const int k_size_classes = 32;
+
+        CrossingArena() : allocations_(0)
+        {
+            clear();
+        }
+
+        /**
+         * @brief releases all blocks, capacity is kept
+         */
+        void clear()
+        {
+            data_.clear();
+            std::fill( free_blocks_, free_blocks_ + k_size_classes, k_none );
+        }
+
+        /**
+         * @brief returns offset of block with \f$2^{size\_class}\f$ elements,
+         * content of block is undefined
+         */
+        std::uint32_t allocate( int size_class )
+        {
+            std::uint32_t offset = free_blocks_[size_class];
+            if ( offset != k_none )
+            {
+                free_blocks_[size_class] = data_[offset];
+                return offset;
+            }
+
+            offset = data_.size();
+            std::size_t capacity = data_.capacity();
+            data_.resize( data_.size() + ( 1u << size_class ) );
+            allocations_ += data_.capacity() > capacity;
+            return offset;
+        }
+
+        void release( std::uint32_t offset, int size_class )
+        {
+            data_[offset] = free_blocks_[size_class];
+            free_blocks_[size_class] = offset;
+        }
+
+        int * getBlock( std::uint32_t offset ) { return data_.data() + offset; }
+        const int * getBlock( std::uint32_t offset ) const { return data_.data() + offset; }
+
+        std::size_t getCapacity() const { return data_.capacity(); }
+
+        /**
+         * @brief number of reallocations of arena storage
+         */
+        std::size_t getAllocations() const { return allocations_; }
+
+    private:
+        static const std::uint32_t k_none = ~0u;
+
+        std::vector<int> data_;
+        std::uint32_t free_blocks_[k_size_classes];
+        std::size_t allocations_;
 };
 
 
@@ -91,30 +200,37 @@ class ERRegion
          */
         ERRegion( int grayLevel, cv::Point p );
 
-        ~ERRegion();
+        // regions are moved, when storage of the tree grows
+        ERRegion( const ERRegion &other ) = default;
+        ERRegion( ERRegion &&other ) = default;
+        ERRegion& operator=( const ERRegion &other ) = default;
+        ERRegion& operator=( ERRegion &&other ) = default;
 
         /**
          * @brief add point to the region
          *
-         * @param point pointer to point 
+         * @param code code of the point
+         * @param point position of the point
          * @param horizontalCrossingChange horizontal crossing change
-         * @param quads 3*3 neighbourhood of the pixel, where false if pixel hasn't been added
-         * else true
+         * @param links pixel lists of the tree, point is appended to the list of region
+         * @param arena storage of horizontal crossings of the tree
          *
          * This method will update all neccessery information and adds the point 
          * to the region.
          */
-        // void addPoint( LinkedPoint *point, int horizontalCrossingChange, bool *quads );
-        void addPoint( LinkedPoint *point, int horizontalCrossingChange);
+        void addPoint( std::uint32_t code, cv::Point point, int horizontalCrossingChange, 
+                PixelLinks &links, CrossingArena &arena );
 
         /**
          * @brief merge region to this region
          *
          * @param other region to merge with
+         * @param arena storage of horizontal crossings of the tree
          *
          * This method will update all information after merging.
+         * Horizontal crossings of \p other are released.
          */
-        void merge( ERRegion &other );
+        void merge( ERRegion &other, CrossingArena &arena );
 
         /**
          * @brief return level of region
@@ -185,11 +301,21 @@ class ERRegion
          */
         CompPtr toCompPtr(); 
 
+        /**
+         * @brief stores positions of region pixels to \p points,
+         * in the same coordinates as in converted component
+         *
+         * @param points output vector, previous content is replaced
+         */
+        void getPoints( std::vector<cv::Point> &points ) const;
+
         /**
          * @brief set median crossing of region, futher details
          * in programming documentation
+         *
+         * @param arena storage of horizontal crossings of the tree
          */
-        void setMedianCrossing(); 
+        void setMedianCrossing( const CrossingArena &arena ); 
 
         /**
          * @brief return features for first stage of er filtering 
@@ -198,6 +324,14 @@ class ERRegion
          */
         std::vector<float> getFeatures() const;
 
+        /**
+         * @brief stores features for first stage of er filtering
+         * to \p features
+         *
+         * @param features array of 4 floats
+         */
+        void getFeatures( float *features ) const;
+
         /**
          * @brief return true if region is similar to reg
          *
@@ -209,6 +343,21 @@ class ERRegion
         
         void updateEulerBit(std::uint16_t quads);
 
+        /**
+         * @brief updates quad counts after adding one pixel
+         *
+         * @param neighbours mask of 8-neighbours already in region, bit i 
+         * is set for neighbour i in order: upper left, upper, upper right, 
+         * left, right, lower left, lower, lower right
+         *
+         * Result is the same as updateEulerBit with mask of four 2x2 quads
+         * around the pixel, change of counts is taken from the table.
+         */
+        void updateEuler( std::uint8_t neighbours )
+        {
+            bit_rec_.update( EulerQuadRecordBit::k_neighbour_deltas[neighbours] );
+        }
+
     private:
 
         struct EulerQuadRecordBit
@@ -218,11 +367,36 @@ class ERRegion
             { 
             }
 
+            /**
+             * change of quad counts caused by one pixel
+             */
+            struct Delta
+            {
+                std::int8_t q1, q2, q2d, q3;
+            };
+
             int q1_count, q2_count, q2d_count, q3_count;
             const static double k_c;
+            const static std::vector<Delta> k_neighbour_deltas;
 
             void update(std::uint16_t quads);
 
+            void update( const Delta &delta )
+            {
+                q1_count += delta.q1;
+                q2_count += delta.q2;
+                q2d_count += delta.q2d;
+                q3_count += delta.q3;
+            }
+
+            /**
+             * @brief mask of four quads around pixel, which is passed 
+             * to update, from mask of its accumulated 8-neighbours
+             */
+            static std::uint16_t getQuadMask( std::uint8_t neighbours );
+
+            static std::vector<Delta> createNeighbourDeltas();
+
             int getEulerNumber() const 
             {
                 return ( q1_count - q3_count + 2 * q2d_count )/4;
@@ -253,29 +427,63 @@ class ERRegion
             }
         };
 
+        /**
+         * Crossings of low regions are stored inline, higher regions
+         * keep crossings in block of CrossingArena with free space on both
+         * sides, so growing by one row is amortized O(1). Block is
+         * reallocated only when merged row range doesn't fit into it.
+         */
         class HorizontalCrossingTracker
         {
             public:
                 HorizontalCrossingTracker() : HorizontalCrossingTracker(-1) { }
 
-                HorizontalCrossingTracker( int row ) : y_max_(row), y_min_(row) 
-                { 
-                    crossings_.push_back(0); 
+                HorizontalCrossingTracker( int row )
+                    : y_max_(row), y_min_(row), first_(0), size_class_(-1), offset_(0)
+                {
+                    inline_[0] = 0;
                 }
-                
-                ~HorizontalCrossingTracker() { }
 
-                void updateHorizontalCrossing( int y, int change );
-                void merge( const HorizontalCrossingTracker &other );
-                int getMedian() const;
+                void updateHorizontalCrossing( int y, int change, CrossingArena &arena );
+                void merge( const HorizontalCrossingTracker &other, CrossingArena &arena );
+                int getMedian( const CrossingArena &arena ) const;
 
-                int getSize() const { return crossings_.size(); }
+                int getSize() const { return y_max_ - y_min_ + 1; }
                 void swap( HorizontalCrossingTracker & other );
+
+                /**
+                 * @brief returns block to the arena, tracker mustn't be used after
+                 */
+                void release( CrossingArena &arena );
             private:
+                static const int k_inline_size = 4;
+
                 int y_max_;
                 int y_min_;
 
-                std::deque<int> crossings_;
+                // position of row y_min_ in storage
+                int first_;
+                // -1 for inline storage
+                int size_class_;
+                std::uint32_t offset_;
+                int inline_[k_inline_size];
+
+                int getCapacity() const
+                {
+                    return size_class_ < 0 ? k_inline_size : 1 << size_class_;
+                }
+
+                int * getData( CrossingArena &arena )
+                {
+                    return size_class_ < 0 ? inline_ : arena.getBlock( offset_ );
+                }
+
+                const int * getData( const CrossingArena &arena ) const
+                {
+                    return size_class_ < 0 ? inline_ : arena.getBlock( offset_ );
+                }
+
+                void extend( int y_min, int y_max, CrossingArena &arena );
         };
 
 
@@ -318,8 +526,9 @@ class ERRegion
         int y_min_;
 
         size_t size_;
-        LinkedPoint *head_;
-        LinkedPoint *tail_;
+        std::uint32_t head_;
+        std::uint32_t tail_;
+        PixelLinks *links_;
 
         CompPtr c_ptr_;
 
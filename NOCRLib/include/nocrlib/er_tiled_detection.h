@@ -0,0 +1,158 @@
+/**
+ * @file er_tiled_detection.h
+ * @brief Contains class ERTiledDetection, that extracts extremal regions
+ * from very large images split into overlapping horizontal strips,
+ * and specialized SegmentationPolicy for its integration with class Segment.
+ */
+
+#ifndef NOCRLIB_ER_TILED_DETECTION_H
+#define NOCRLIB_ER_TILED_DETECTION_H
+
+#include "extremal_region.h"
+#include "segment.h"
+#include "component.h"
+
+#include <opencv2/core/core.hpp>
+
+#include <vector>
+#include <memory>
+#include <string>
+
+/**
+ * @brief method class for er text extraction from very large images
+ *
+ * Image is split into horizontal strips overlapping by fixed number of
+ * rows. Every strip is processed by ERTextDetection owned by one of the
+ * worker threads, so working memory of each thread is limited by the strip
+ * size. Letters cut by the seam between two strips are joined, if they
+ * match in the overlapping rows, letters fitting into the overlap are
+ * taken from the strip, in which they aren't cut.
+ *
+ * Parts of a cut letter are classified separately. If only one part passes
+ * both stages, it is returned alone. So letters higher than the overlap can
+ * be returned as parts or missed, only letters lower than the overlap are
+ * guaranteed to be whole in some strip.
+ *
+ * This class isn't copyable and copy-assignable.
+ */
+class ERTiledDetection
+{
+    public:
+        typedef Component Storage;
+
+        /**
+         * @brief initialize object with configuration files
+         *
+         * @param first_stage_conf configuration file for first stage of ER
+         * @param second_stage_conf configuration file for second stage of ER
+         */
+        ERTiledDetection( const std::string &first_stage_conf,
+                const std::string &second_stage_conf );
+
+        ERTiledDetection( const ERTiledDetection &other ) = delete;
+        ERTiledDetection& operator=( const ERTiledDetection &other ) = delete;
+
+        /**
+         * @brief finds letter candidates in image
+         *
+         * @param image input image, CV8UC3 required format
+         *
+         * @return vector of letter candidates
+         *
+         * Images with area not greater than min tiled area are processed
+         * as whole.
+         */
+        std::vector<Storage> getLetters( const cv::Mat &image );
+
+        /**
+         * @brief set number of rows of one strip without overlap
+         *
+         * @param strip_height must be greater than 0
+         */
+        void setStripHeight( int strip_height )
+        {
+            strip_height_ = strip_height;
+        }
+
+        /**
+         * @brief set number of rows shared by two neighbouring strips
+         *
+         * @param overlap must be greater than 0, letters lower than
+         * overlap are never cut by the seam
+         */
+        void setOverlap( int overlap )
+        {
+            overlap_ = overlap;
+        }
+
+        /**
+         * @brief set number of worker threads
+         *
+         * @param thread_count must be greater than 0
+         */
+        void setThreadCount( unsigned thread_count );
+
+        /**
+         * @brief set minimal area of image to be split into strips
+         *
+         * @param min_tiled_area area in pixels
+         */
+        void setMinTiledArea( int min_tiled_area )
+        {
+            min_tiled_area_ = min_tiled_area;
+        }
+
+        /**
+         * @brief tree holding the configuration shared by all workers
+         *
+         * @return reference to ERTree
+         */
+        ERTree & getTree()
+        {
+            return detection_.getTree();
+        }
+
+    private:
+        ERTextDetection detection_;
+        std::vector< std::unique_ptr<ERTextDetection> > workers_;
+
+        int strip_height_ = 512;
+        int overlap_ = 128;
+        int min_tiled_area_ = 1600 * 1200;
+
+        const static double k_min_seam_similarity;
+
+        std::vector<cv::Range> getStrips( int rows ) const;
+
+        std::vector< std::vector<Storage> > processStrips( const cv::Mat &image,
+                const std::vector<cv::Range> &strips );
+
+        std::vector<Storage> mergeStrips(
+                const std::vector< std::vector<Storage> > &strip_letters,
+                const std::vector<cv::Range> &strips ) const;
+
+        int findSeamPartner( const std::vector<Storage> &open_letters,
+                const Storage &letter, const cv::Range &seam ) const;
+
+        static Storage join( const Storage &upper, const Storage &lower, int seam_end );
+        static std::vector<cv::Point> getSeamPoints( const Storage &letter,
+                const cv::Range &seam );
+};
+
+/**
+ * @brief Specified policy class SegmentationPolicy for ERTiledDetection
+ */
+template <>
+class SegmentationPolicy<ERTiledDetection>
+    : public SegmentationPolicy<ERTextDetection>
+{
+    public:
+        static std::vector<MethodOutput> extract
+            ( ERTiledDetection * er_detection,
+              const cv::Mat &image )
+        {
+            return er_detection->getLetters(image);
+        }
+};
+
+#endif /* er_tiled_detection.h */
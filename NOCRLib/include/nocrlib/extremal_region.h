@@ -14,18 +14,16 @@
 
 #include "er_region.h"
 #include "component_tree_builder.h"
-#include "component_tree_node.h"
+#include "union_find_tree_builder.h"
+#include "flat_component_tree.h"
 #include "component.h"
 #include "classifier_wrap.h"
 #include "feature_traits.h"
 #include "utilities.h"
+#include "deadline.h"
 
 #include <opencv2/core/core.hpp>
 
-#include <boost/pool/pool.hpp>
-#include <boost/pool/object_pool.hpp>
-#include <boost/pool/pool_alloc.hpp>
-
 #include <vector>
 #include <memory>
 
@@ -93,6 +91,7 @@ class ERFilter1Stage : public ERFunctionInterface
         void loadConfiguration( const std::string &conf )
         {
             boost_.loadConfiguration( conf ); 
+            boost_.compile( flat_boost_ );
         }
 
         /**
@@ -106,10 +105,26 @@ class ERFilter1Stage : public ERFunctionInterface
          * Function returns probability $P(r|character)$. If no 
          * configuration file will be loaded, assertion will fail.
          * For further see the programming documentation.
+         * Flattened trees are used, when the configuration could be flattened.
          * */
         float getProbability( const ERRegion &r ) override;
+
+        /**
+         * @brief weighted sum of decision functions of boosting
+         * evaluated by OpenCV, used for comparison with flattened trees
+         */
+        float getOpenCVSum( const ERRegion &r ) const;
+
+        /**
+         * @brief weighted sum of decision functions of boosting
+         * evaluated by flattened trees
+         */
+        float getFlatSum( const ERRegion &r ) const;
+
+        const FlatBoost & getFlatBoost() const { return flat_boost_; }
     private:
         Boost<feature::ERGeom> boost_; 
+        FlatBoost flat_boost_;
 
 };
 
@@ -180,6 +195,26 @@ class ERFilter2Stage
          * @return true if r is letter candidate else false
          */
         bool isLetter( ERRegion &r );
+
+        /**
+         * @brief computes features of second stage from pixels of region
+         *
+         * @param r region we compute features for
+         *
+         * @return first stage features followed by hole area ratio, 
+         * convexity and number of inflection points
+         *
+         * Values are equal to the features computed by BackgroundMergeRule 
+         * and InflectionPoints from binary image of converted component, 
+         * but binary image isn't created.
+         */
+        std::vector<float> getFeatures( const ERRegion &r ) const;
+
+        /**
+         * @brief computes the same features as getFeatures from binary 
+         * image of converted component
+         */
+        std::vector<float> getRasterFeatures( const ERRegion &r );
     private:
         std::unique_ptr<AbstractFeatureExtractor> features_extractor_;
 
@@ -198,7 +233,8 @@ class ERFilter2Stage
 class ERTree
 {
     public:
-        typedef ComponentTreeNode<ERRegion> NodeType;
+        typedef FlatComponentTree<ERRegion> TreeType;
+        typedef TreeType::NodeId NodeId;
 
         /**
          * @brief default constructor sets min area to 0 and max
@@ -206,7 +242,9 @@ class ERTree
          * as letter candidates.
          */
         ERTree() 
-            : root_(nullptr), min_area_ratio_(0), max_area_ratio_(1) 
+            : root_(TreeType::k_none), second_stage_threads_(getDefaultThreadCount()),
+            filter2_(std::make_shared<ERFilter2Stage>()),
+            min_area_ratio_(0), max_area_ratio_(1) 
         { 
         }
 
@@ -240,17 +278,6 @@ class ERTree
          */
         ERTree& operator=( const ERTree& other) = delete;
 
-        /**
-         * @brief destructor
-         */
-        ~ERTree() 
-        {
-            if (root_ != nullptr)
-            {
-                deallocateTree();
-            }
-        }
-
         /**
          * @brief load configuration file for the second stage
          *
@@ -293,6 +320,14 @@ class ERTree
             max_area_ratio_ = max_area_ratio;
         }
 
+        /**
+         * @brief set number of threads evaluating second stage classifier
+         *
+         * @param thread_count must be greater than 0, 1 means the calling 
+         * thread evaluates all nodes
+         */
+        void setSecondStageThreadCount( unsigned thread_count );
+
         /**
          * @brief minimum probability for er detection
          *
@@ -306,6 +341,31 @@ class ERTree
             min_global_prob_ = min_global_prob;
         }
 
+        /**
+         * @brief set maximal number of nodes evaluated by the second stage
+         *
+         * @param candidate_budget 0 means unlimited
+         *
+         * If more nodes pass the first stage, only \p candidate_budget nodes 
+         * with the highest first stage probability are evaluated, so the 
+         * probability threshold is raised for this tree. Number of letters 
+         * and so ocr and nonmax suppresion are bounded by the budget.
+         */
+        void setCandidateBudget( std::size_t candidate_budget )
+        {
+            candidate_budget_ = candidate_budget;
+        }
+
+        /**
+         * @brief number of trees, in which candidates exceeded the budget
+         *
+         * @return count of budget triggers since construction of the tree
+         */
+        std::size_t getBudgetTriggers() const
+        {
+            return budget_triggers_;
+        }
+
         /**
          * @brief minimum difference between local minumum
          * and maximum
@@ -341,24 +401,46 @@ class ERTree
         }
 
         /**
-         * @brief release unique pointer of er function for the first phase
+         * @brief release pointer of er function for the first phase
          * sets the current er function to nullptr
          *
-         * @return unique pointer to er function
+         * @return shared pointer to er function
          */
-        std::unique_ptr<ERFunctionInterface> releaseERFunction() 
+        std::shared_ptr<ERFunctionInterface> releaseERFunction() 
         {
-            std::unique_ptr<ERFunctionInterface> tmp;
+            std::shared_ptr<ERFunctionInterface> tmp;
             tmp.swap( er_function_ );
             return tmp;
         }
 
+        /**
+         * @brief shares classifiers of both stages with \p other and 
+         * copies its thresholds 
+         *
+         * @param other tree with loaded configuration
+         *
+         * Classifiers are only read during building and filtering of
+         * the tree, so both trees can be processed on different threads.
+         */
+        void shareConfiguration( const ERTree &other );
+
         /**
          * @brief return domain image
          *
          * @return domain image
          */
         cv::Mat getDomain() const { return bitmap_; }
+
+        /**
+         * @brief number of reallocations of image buffers
+         *
+         * @return count of buffers, that had to grow in setImage and 
+         * of reallocations of crossing arena since construction of the tree
+         */
+        std::size_t getAllocations() const 
+        { 
+            return allocations_ + crossing_arena_.getAllocations(); 
+        }
         /**
          * @brief invert domain image I = 255 - I;
          */
@@ -369,9 +451,9 @@ class ERTree
         /**
          * @brief deallocate the all tree nodes from root to lists
          *
-         * @param root root of component tree
+         * All nodes are released at once, storage keeps its capacity
+         * for the next tree.
          */
-        // void deallocateTree( NodeType *root );
         void deallocateTree();
 
         /**
@@ -385,6 +467,9 @@ class ERTree
          *
          * This function perform only second stage of filtering of the algorithm. Following 
          * the steps described in my bachalor thesis following the work of Neumann and Matas.
+         * Output is the same as after transformExtreme, transform2StageFiltering, 
+         * rejectSimilar and processTree with ComponentExtractor, but nodes are only 
+         * marked and the tree is traversed once with explicit stack.
          */
         std::vector< Component > getLetters(bool deallocate = true);
         // std::vector< LetterStorage<ERStat> > getLetters( NodeType * root, bool deallocate = true );
@@ -416,7 +501,8 @@ class ERTree
          * @brief transform tree using the er 2 stage classifier,
          *
          * Removes all nodes from tree ,that are classified as non letter by 
-         * er 2 stage classifier
+         * er 2 stage classifier. Nodes are classified in batches by second 
+         * stage threads, nodes are removed in one pass after all decisions.
          */
         void transform2StageFiltering();
 
@@ -433,36 +519,54 @@ class ERTree
         template <typename Functor>
         void processTree(Functor & functor)
         {
-            return root_->visit(functor);
+            return tree_.visit(root_, functor);
         }
 
     private:
-        friend class ComponentTreeBuilder<ERTree>;
+        template <typename, template <typename> class> 
+        friend class ComponentTreeBuilder;
+        template <typename>
+        friend class UnionFindTreeBuilder;
         friend class ComponentTreePolicy<ERTree>;
 
         // class methods
-        ComponentTreeNode<ERRegion> * root_;
-        boost::fast_pool_allocator<
-            NodeType, 
-            boost::default_user_allocator_new_delete, 
-            boost::details::pool::null_mutex,
-            32> memory_pool_allocator_;
+        NodeId root_;
+        TreeType tree_;
+        std::vector<NodeId> rejected_nodes_;
+        std::vector<NodeId> candidate_nodes_;
+        std::vector<char> letter_decisions_;
+        std::vector<char> kept_nodes_;
+        // pairs of node and its nearest kept ancestor
+        std::vector< std::pair<NodeId, NodeId> > traversal_stack_;
+
+        unsigned second_stage_threads_;
+        const static std::size_t k_second_stage_batch = 16;
         
         int cols_, rows_;
+        cv::Mat gray_image_;
         cv::Mat bitmap_;
-        size_t processed_points_;
+        std::size_t allocations_ = 0;
 
         // cv::Mat4b value_mat_;
-        std::vector<LinkedPoint> points_;
-        std::vector<bool> accumulated_pixels_;
-
-        std::unique_ptr<ERFunctionInterface> er_function_;
+        PixelLinks pixel_links_;
+        CrossingArena crossing_arena_;
+        // level of accumulated pixel or k_not_accumulated, so neighbour
+        // is accumulated with lower or equal level, iff its key <= level
+        std::vector<std::int16_t> accumulated_keys_;
+        const static std::int16_t k_not_accumulated = 256;
+        // keys of 4 neighbours in row are loaded at once
+        const static int k_keys_padding = 4;
+
+        std::shared_ptr<ERFunctionInterface> er_function_;
         // ERFilter1Stage filter1_;
-        ERFilter2Stage filter2_;
+        std::shared_ptr<ERFilter2Stage> filter2_;
 
         float min_global_prob_ = 0.2f;
         float min_delta_ = 0.1f;
 
+        std::size_t candidate_budget_ = 0;
+        std::size_t budget_triggers_ = 0;
+
         double min_area_ratio_, max_area_ratio_;
         const int min_area_limit = 20;
         int min_area_, max_area_;
@@ -479,7 +583,13 @@ class ERTree
          *
          * Pixels are coded by following formula \f$code = y * domain.width + x \f$ 
          */
-        void accumulate( NodeType *reg, int code ); 
+        void accumulate( NodeId reg, int code ); 
+
+        /**
+         * @brief returns mask of 8-neighbours of \p code, which were 
+         * accumulated with lower or equal level, see ERRegion::updateEuler
+         */
+        std::uint8_t getAccumulatedNeighbours( int code ) const;
 
         /**
          * @brief connect node child to parent node as his new child.
@@ -490,14 +600,23 @@ class ERTree
          * This function takes care of structural connecting child to the parent, 
          * and also updates parent node after adding new node \p child.
          */
-        void merge( NodeType *child, NodeType *parent );
+        void merge( NodeId child, NodeId parent );
 
+        /**
+         * @brief unites two nodes of the same level
+         *
+         * @param node node, that is merged into \p target and destroyed
+         * @param target node, that takes pixels and children of \p node
+         *
+         * Used by UnionFindTreeBuilder, when two parts of one plateau meet.
+         */
+        void join( NodeId node, NodeId target );
 
-        NodeType * createNode(cv::Point pixel, int level);
+        NodeId createNode(cv::Point pixel, int level);
 
-        NodeType * createRootNode();
+        NodeId createRootNode();
 
-        void destroyNode(NodeType * node);
+        void destroyNode(NodeId node);
 
 
         // private methods of class
@@ -507,7 +626,7 @@ class ERTree
         }
 
 
-        void saveTree( NodeType *root, std::vector<NodeType*> &nodes ) const;
+        void saveTree( NodeId root, std::vector<NodeId> &nodes ) const;
         
 
         // template <typename Functor> 
@@ -529,42 +648,51 @@ class ERTree
         //     return result;
         // }
         
+        /**
+         * @brief removes all nodes except root, for which \p functor returns false
+         *
+         * @param functor predicate taking NodeId
+         *
+         * Predicate is evaluated for all nodes in one linear scan over the tree
+         * storage before any node is removed, so every node sees the tree
+         * as it was before the transformation. Children of removed node are
+         * reconnected to its parent.
+         */
         template <typename Functor>
-        bool transform(Functor && functor, NodeType * root)
+        void transform(Functor && functor)
         {
-            bool result = functor(root);
-            root->size_ = 1;
-             
-            NodeType * child = root->child_;
-            while( child != nullptr )
+            rejected_nodes_.clear();
+            for ( NodeId node = 0; node < tree_.getSize(); ++node )
             {
-                NodeType * tmp = child->next_;
-                if ( !transform(functor, child) )
+                if ( node != root_ && tree_.isAlive(node) && !functor(node) )
                 {
-                    root->size_ += child->size_;
-                    child->remove();
-                    // memory_pool_.destroy(child);
-                    memory_pool_allocator_.destroy(child);
-                    memory_pool_allocator_.deallocate(child);
+                    rejected_nodes_.push_back( node );
                 }
-                else
-                {
-                    root->size_ += child->size_;
-                }
-
-                child = tmp;
             }
 
-            return result;
+            removeRejectedNodes();
         }
 
-        bool isExtremeRegion( NodeType *reg );
-        std::pair<float,float> findExtremeParentProb(NodeType *child_region);
+        void removeRejectedNodes();
+        void classifyCandidates();
+
+        /**
+         * @brief keeps only candidates with the highest probability,
+         * if their number exceeds the budget, candidates stay sorted by id
+         */
+        void applyCandidateBudget();
+        void pushChildren( NodeId node, NodeId ancestor );
+
+        static unsigned getDefaultThreadCount();
+
+        bool isExtremeRegion( NodeId reg );
+        std::pair<float,float> findExtremeParentProb(NodeId child_region);
 
-        bool testSimilarChildren( NodeType *r );
-        bool checkChildren( NodeType *reg, int min_area, float probability );
-        bool testSimilarParent( NodeType *r );
+        bool testSimilarChildren( NodeId r );
+        bool checkChildren( NodeId reg, int min_area, float probability );
+        bool testSimilarParent( NodeId r );
 
+        bool isDifferentFromParent( NodeId node, NodeId parent ) const;
         static std::size_t getMinSizeDiff(std::size_t size);
 };
 
@@ -575,32 +703,106 @@ class ERTree
 template <> class ComponentTreePolicy<ERTree>
 {
     public:
-        typedef ComponentTreeNode<ERRegion> NodeType;
+        typedef ERTree::NodeId NodeId;
     
         static void init( const cv::Mat &bitmap, std::vector<bool> &accesible_mask, 
                 int * init_pixel_code )
         {
-            accesible_mask = helper::getAccesibilityMaskWithNegativeBorder( bitmap );
+            helper::setAccesibilityMaskWithNegativeBorder( bitmap, accesible_mask );
             // stack.push( new NodeType(256) );
             *init_pixel_code = bitmap.cols + 1;
             accesible_mask[*init_pixel_code] = true;
         }
 
-        static NodeType* createNode( int level, cv::Point p )
+        static int getLevel( ERTree * extremal_region, NodeId node )
+        {
+            return extremal_region->tree_.getVal(node).getLevel();
+        }
+
+        static void setRoot( NodeId root, ERTree * extremal_region )
+        {
+            extremal_region->root_ = root;
+        }
+};
+
+/**
+ * @brief workspace for building ERTree over many images
+ *
+ * Keeps ComponentTreeBuilder alive between images, so its accessibility
+ * mask, boundary heap and node stack keep their capacity the same way
+ * as image buffers of the tree. Images of the same size are processed
+ * without reallocation of any of these buffers.
+ *
+ * This class isn't copyable and copy-assignable.
+ */
+class ERWorkspace
+{
+    public:
+        typedef ERTree::NodeId NodeId;
+
+        /**
+         * @param er_tree tree, that will be built in workspace, 
+         * it must outlive the workspace
+         */
+        ERWorkspace( ERTree *er_tree )
+            : er_tree_(er_tree), builder_(er_tree), 
+            images_(0), initial_allocations_(er_tree->getAllocations())
+        {
+        }
+
+        ERWorkspace( const ERWorkspace &other ) = delete;
+        ERWorkspace& operator=( const ERWorkspace &other ) = delete;
+
+        /**
+         * @brief loads image into the tree, see ERTree::setImage
+         */
+        void setImage( const cv::Mat &image )
         {
-            ERRegion r( level, p );
-            return new NodeType(r);
+            ++images_;
+            er_tree_->setImage( image );
         }
 
-        static int getLevel( NodeType* node )
+        /**
+         * @brief builds component tree of current domain of the tree
+         *
+         * @return root of the tree
+         */
+        NodeId buildTree()
         {
-            return node->getVal().getLevel();
+            return builder_.buildTree();
         }
 
-        static void setRoot( NodeType * root, ERTree * extremal_region )
+        ERTree & getTree() 
         {
-            extremal_region->root_ = root;
+            return *er_tree_;
+        }
+
+        /**
+         * @brief number of images loaded into workspace
+         */
+        std::size_t getImages() const { return images_; }
+
+        /**
+         * @brief number of buffer reallocations of the tree and 
+         * the builder since construction of workspace
+         */
+        std::size_t getAllocations() const 
+        {
+            return er_tree_->getAllocations() - initial_allocations_ 
+                + builder_.getAllocations();
         }
+
+        double getAllocationsPerImage() const
+        {
+            return images_ ? (double) getAllocations() / images_ : 0;
+        }
+
+    private:
+        ERTree *er_tree_;
+        ComponentTreeBuilder<ERTree> builder_;
+
+        std::size_t images_;
+        std::size_t initial_allocations_;
 };
 
 // ===========policy class for segment integration of extremal regions ==========
@@ -643,13 +845,103 @@ class ERTextDetection
          */
         std::vector< Storage > getLetters(const cv::Mat &image);
 
+        /**
+         * @brief finds letter candidates in part of larger image
+         *
+         * @param image part of input image, CV8UC3 required format
+         * @param domain_size size of whole input image
+         *
+         * @return vector of letters candidates in coordinates of \p image
+         *
+         * Bounds of region size are computed for \p domain_size instead of
+         * size of \p image, so letters are limited the same way as if the
+         * whole image was processed.
+         */
+        std::vector< Storage > getLetters(const cv::Mat &image, const cv::Size &domain_size);
+
+        /**
+         * @brief finds letter candidates in region of interest of image
+         *
+         * @param image input image, CV8UC3 required format
+         * @param roi region of interest, it must lie inside \p image
+         *
+         * @return vector of letters candidates in coordinates of \p image
+         *
+         * Only pixels of \p roi are processed, bounds of region size are
+         * computed for the whole \p image.
+         */
+        std::vector< Storage > getLetters(const cv::Mat &image, const cv::Rect &roi);
+
+        /**
+         * @brief finds letter candidates in image until deadline
+         *
+         * @param image input image, CV8UC3 required format
+         * @param deadline checked after the first polarity pass
+         * @param truncated set to true, if the second polarity was skipped
+         *
+         * @return vector of letters candidates 
+         *
+         * If the deadline expires during the pass over dark letters, bright 
+         * letters aren't searched. With parallel polarity both passes run 
+         * to their end.
+         */
+        std::vector< Storage > getLetters(const cv::Mat &image, const Deadline &deadline, 
+                bool &truncated);
+
         ERTree & getTree() 
         {
             return extremal_region_;
         }
 
+        /**
+         * @brief enable/disable processing of dark and bright letters
+         * on two threads
+         *
+         * @param parallel true enable, false disable
+         *
+         * If enabled, inverted domain is processed by second ERTree sharing
+         * classifiers with the tree returned by getTree(). Output is
+         * the same as in serial mode.
+         */
+        void setParallelPolarity( bool parallel )
+        {
+            parallel_polarity_ = parallel;
+        }
+
+        /**
+         * @brief workspace of the tree returned by getTree()
+         *
+         * @return const reference to ERWorkspace, allocation counters
+         * can be read from it
+         */
+        const ERWorkspace & getWorkspace() const
+        {
+            return workspace_;
+        }
+
+        /**
+         * @brief number of trees of both polarities, in which candidates
+         * exceeded the budget, see ERTree::setCandidateBudget
+         */
+        std::size_t getBudgetTriggers() const
+        {
+            return extremal_region_.getBudgetTriggers() + inverted_region_.getBudgetTriggers();
+        }
+
     private:
         ERTree extremal_region_;
+        ERTree inverted_region_;
+
+        ERWorkspace workspace_{ &extremal_region_ };
+        ERWorkspace inverted_workspace_{ &inverted_region_ };
+
+        bool parallel_polarity_ = false;
+
+        void setUpTree( ERWorkspace &workspace, const cv::Mat &image, const cv::Size &domain_size );
+        std::vector< Storage > extractLetters( ERWorkspace &workspace );
+        std::vector< Storage > getLettersParallel( const cv::Mat &image, const cv::Size &domain_size );
+        std::vector< Storage > getLettersSerial( const cv::Mat &image, const cv::Size &domain_size,
+                const Deadline &deadline, bool &truncated );
 };
 
 
@@ -691,6 +983,13 @@ class SegmentationPolicy<ERTextDetection>
             return er_text_detection->getLetters(image);
         }
 
+        static std::vector<MethodOutput> extract
+            ( ERTextDetection * er_text_detection,
+              const cv::Mat &image, const Deadline &deadline, bool &truncated )
+        {
+            return er_text_detection->getLetters(image, deadline, truncated);
+        }
+
         static bool haveSignificantOverlap( const Component &a, 
                 const Component &b )
         {
@@ -738,6 +1037,16 @@ public:
     static std::pair<double, double> getErSizeLimits(const cv::Size & size);
 };
 
+class ErDuplicateFilter
+{
+public:
+    /**
+     * @brief merges vectors of letter candidates, candidates with same 
+     * bounding box and size are kept only once
+     */
+    static std::vector<Component> filter(const std::vector< std::vector<Component> > & components);
+};
+
 /**
  * @brief builds er_tree, and process the tree with \p functor
  *
@@ -183,9 +183,14 @@ class InflectionPoints : public AbstractFeatureExtractor
 {
     public:
         std::vector<float> compute( Component &c ) override;
+
+        /**
+         * @brief computes number of inflection points of contour 
+         * approximated by polygon with precision \p eps
+         */
+        static int computeNumberOfInflections( const std::vector<cv::Point> &points, double eps );
     private:
         size_t computeHullArea( const std::vector<cv::Point> &points );
-        int computeNumberOfInflections( const std::vector<cv::Point> &points, double eps );
         
 };
 
@@ -0,0 +1,270 @@
+/**
+ * @file flat_component_tree.h
+ * @brief This file contains class FlatComponentTree, index addressed
+ * storage of component tree, which keeps all nodes in contiguous arrays.
+ */
+
+#ifndef NOCRLIB_FLAT_COMPONENT_TREE_H
+#define NOCRLIB_FLAT_COMPONENT_TREE_H
+
+#include <vector>
+#include <utility>
+#include <cstddef>
+
+/**
+ * @brief FlatComponentTree stores component tree in arrays indexed
+ * by node id
+ *
+ * @tparam T type T specifies the type of class, that contain
+ * neccesery information about component.
+ *
+ * Structure of the tree is kept in separate arrays of parent, first child,
+ * last child, next and previous sibling, values of nodes are kept in one
+ * array of T. Destroyed nodes are reused by following createNode, so
+ * storage doesn't grow more than the maximal number of living nodes.
+ * All nodes are released by one call of clear, capacity of arrays is kept
+ * for next tree. Semantic of addChild, reconnectChildren and remove is
+ * the same as in ComponentTreeNode, so trees of both storages have the same
+ * order of children.
+ */
+template <typename T>
+class FlatComponentTree
+{
+    public:
+        typedef int NodeId;
+        typedef T ValueType;
+
+        static const NodeId k_none = -1;
+
+        FlatComponentTree() : node_count_(0) { }
+
+        /**
+         * @brief creates new node, that isn't connected to any other node
+         *
+         * @param args arguments passed to the constructor of T
+         *
+         * @return id of new node
+         */
+        template <typename ... ARGS>
+        NodeId createNode( ARGS &&... args )
+        {
+            NodeId id;
+            if ( !free_nodes_.empty() )
+            {
+                id = free_nodes_.back();
+                free_nodes_.pop_back();
+                values_[id] = T( std::forward<ARGS>(args)... );
+                parent_[id] = first_child_[id] = last_child_[id] = k_none;
+                next_[id] = prev_[id] = k_none;
+            }
+            else
+            {
+                id = values_.size();
+                values_.emplace_back( std::forward<ARGS>(args)... );
+                parent_.push_back( k_none );
+                first_child_.push_back( k_none );
+                last_child_.push_back( k_none );
+                next_.push_back( k_none );
+                prev_.push_back( k_none );
+                alive_.push_back( false );
+            }
+
+            alive_[id] = true;
+            ++node_count_;
+            return id;
+        }
+
+        /**
+         * @brief releases node, node must be disconnected from the tree
+         *
+         * @param id id of released node
+         */
+        void destroyNode( NodeId id )
+        {
+            alive_[id] = false;
+            free_nodes_.push_back( id );
+            --node_count_;
+        }
+
+        /**
+         * @brief releases all nodes, capacity of arrays is kept
+         */
+        void clear()
+        {
+            values_.clear();
+            parent_.clear();
+            first_child_.clear();
+            last_child_.clear();
+            next_.clear();
+            prev_.clear();
+            alive_.clear();
+            free_nodes_.clear();
+            node_count_ = 0;
+        }
+
+        /**
+         * @brief prepend \p child to the children of \p parent
+         */
+        void addChild( NodeId parent, NodeId child )
+        {
+            NodeId first = first_child_[parent];
+            next_[child] = first;
+            prev_[child] = k_none;
+            if ( first != k_none )
+            {
+                prev_[first] = child;
+            }
+            else
+            {
+                last_child_[parent] = child;
+            }
+
+            first_child_[parent] = child;
+            parent_[child] = parent;
+        }
+
+        /**
+         * @brief reconnects all children of \p node to \p parent,
+         * \p node is disconnected, but not destroyed
+         */
+        void reconnectChildren( NodeId parent, NodeId node )
+        {
+            addChild( parent, node );
+            remove( node );
+        }
+
+        /**
+         * @brief remove \p node from its parent, and reconnect
+         * its children to its parent on its position
+         */
+        void remove( NodeId node )
+        {
+            NodeId parent = parent_[node];
+            NodeId prev = prev_[node];
+            NodeId next = next_[node];
+
+            NodeId first = first_child_[node];
+            NodeId last = last_child_[node];
+            for ( NodeId child = first; child != k_none; child = next_[child] )
+            {
+                parent_[child] = parent;
+            }
+
+            if ( first == k_none )
+            {
+                // node is replaced by nothing
+                first = next;
+                last = prev;
+            }
+            else
+            {
+                prev_[first] = prev;
+                next_[last] = next;
+            }
+
+            if ( prev != k_none )
+            {
+                next_[prev] = first;
+            }
+            else
+            {
+                first_child_[parent] = first;
+            }
+
+            if ( next != k_none )
+            {
+                prev_[next] = last;
+            }
+            else
+            {
+                last_child_[parent] = last;
+            }
+
+            parent_[node] = first_child_[node] = last_child_[node] = k_none;
+            next_[node] = prev_[node] = k_none;
+        }
+
+        /**
+         * @brief stores all descendants of \p root in order of depth
+         * first search, the same order is used in visit
+         */
+        void getDescendants( NodeId root, std::vector<NodeId> &nodes ) const
+        {
+            std::vector<NodeId> stack_node;
+            pushChildren( root, stack_node );
+            while( !stack_node.empty() )
+            {
+                NodeId top_stack = stack_node.back();
+                stack_node.pop_back();
+                nodes.push_back( top_stack );
+                pushChildren( top_stack, stack_node );
+            }
+        }
+
+        /**
+         * @brief calls \p functor with value of every descendant of \p root
+         */
+        template <typename Functor>
+        void visit( NodeId root, Functor && functor )
+        {
+            std::vector<NodeId> stack_node;
+            pushChildren( root, stack_node );
+            while( !stack_node.empty() )
+            {
+                NodeId top_stack = stack_node.back();
+                stack_node.pop_back();
+                functor( values_[top_stack] );
+                pushChildren( top_stack, stack_node );
+            }
+        }
+
+        T& getVal( NodeId id ) { return values_[id]; }
+        const T& getVal( NodeId id ) const { return values_[id]; }
+
+        NodeId getParent( NodeId id ) const { return parent_[id]; }
+        NodeId getFirstChild( NodeId id ) const { return first_child_[id]; }
+        NodeId getNext( NodeId id ) const { return next_[id]; }
+
+        /**
+         * @brief return true, if id belongs to created and not destroyed node,
+         * ids are in range [0, getSize())
+         */
+        bool isAlive( NodeId id ) const { return alive_[id]; }
+
+        /**
+         * @brief upper bound of node ids
+         */
+        NodeId getSize() const { return values_.size(); }
+
+        /**
+         * @brief number of living nodes
+         */
+        std::size_t getNodeCount() const { return node_count_; }
+
+        std::size_t getCapacity() const { return values_.capacity(); }
+
+    private:
+        std::vector<T> values_;
+        std::vector<NodeId> parent_;
+        std::vector<NodeId> first_child_;
+        std::vector<NodeId> last_child_;
+        std::vector<NodeId> next_;
+        std::vector<NodeId> prev_;
+        std::vector<bool> alive_;
+
+        std::vector<NodeId> free_nodes_;
+        std::size_t node_count_;
+
+        void pushChildren( NodeId node, std::vector<NodeId> &stack_node ) const
+        {
+            for ( NodeId child = first_child_[node]; child != k_none; child = next_[child] )
+            {
+                stack_node.push_back( child );
+            }
+        }
+};
+
+template <typename T>
+const typename FlatComponentTree<T>::NodeId FlatComponentTree<T>::k_none;
+
+#endif /* flat_component_tree.h */
@@ -17,10 +17,12 @@
 #include <string>
 #include <ostream>
 #include <thread>
+#include <memory>
 
 #include <pugi/pugixml.hpp>
 
 #include "assert.h"
+#include "svm_voting.h"
 
 
 /// @cond
@@ -81,6 +83,15 @@ class DecisionFunction
 
 class IKSVM;
 
+/**
+ * @brief storage of IKSVM block tables
+ *
+ * Quantized tables store values of every classifier as integers
+ * with per-classifier scale and offset, so they are 2 or 4 times smaller
+ * than float tables and more of them stays in cache.
+ */
+enum class IKSVMQuantization { none, int16, int8 };
+
 /**
  * @brief class that converts class svm_problem from LibSVM to svm with fast 
  * intersection kernel proposed by Malik and co.
@@ -125,6 +136,19 @@ class IKSVMConvertor
          */
         IKSVM createFromSvmProblem( const std::string &problem_file, int num_segment );
 
+        /**
+         * @brief converts float tables of iksvm to quantized tables
+         *
+         * @param model iksvm with float tables
+         * @param quantization type of quantized tables
+         *
+         * @return copy of \p model, that uses quantized tables for prediction
+         *
+         * Decision values differ from \p model by rounding error of quantization,
+         * reference evaluator still uses the original double tables.
+         */
+        IKSVM quantize( const IKSVM &model, IKSVMQuantization quantization );
+
     private:
         template <typename T> using Matrix = std::vector< std::vector<T> >;
 
@@ -156,18 +180,63 @@ class IKSVMConvertor
 
 };
 
+/**
+ * @brief buffers of IKSVM prediction owned by caller
+ *
+ * Const prediction methods of IKSVM taking workspace keep all temporary
+ * data in it, so one model can be used by many threads, each with its own
+ * workspace. Buffers keep their capacity, so repeated prediction with
+ * the same workspace doesn't allocate. Workspace isn't bound to model.
+ */
+class IKSVMWorkspace
+{
+    public:
+        IKSVMWorkspace() = default;
+
+    private:
+        std::vector<double> decision_values_;
+        std::vector<double> block_sums_;
+
+        // nr_class x nr_class matrices of multiclass probability with row pointers
+        std::vector<double> pairwise_prob_;
+        std::vector<double *> pairwise_rows_;
+        std::vector<double> q_;
+        std::vector<double *> q_rows_;
+        std::vector<double> qp_;
+
+        SvmVoteBuffers vote_buffers_;
+
+        void prepareProbability( int nr_class );
+
+        friend class IKSVM;
+};
+
 /**
  * @brief represents svm with fast intersection kernel
+ *
+ * Prediction methods are const and don't modify the model, methods without
+ * IKSVMWorkspace use temporary workspace.
  */
 class IKSVM
 {
     public:
+        /**
+         * @brief implementation of decision function evaluation
+         *
+         * Vectorized evaluators use float copy of decision functions
+         * and evaluate 8 classifiers at once, reference evaluator uses
+         * the original double tables.
+         */
+        enum class Evaluator { reference, scalar, sse2, avx2 };
+
         IKSVM() : nr_class_(0), features_dim_(-1) { }
 
         /**
          * @brief save iksvm configuration to file 
          *
          * @param file path to file
+         *
+         * Text format contains the original tables, quantization isn't saved.
          */
         void save( const std::string &file );
 
@@ -175,30 +244,69 @@ class IKSVM
         
 
         /**
-         * @brief loads iksvm configuration from file
+         * @brief save iksvm in binary format, that can be loaded
+         * without parsing
          *
          * @param file path to file
          */
+        void saveBinary( const std::string &file );
+
+        /**
+         * @brief loads iksvm configuration from file
+         *
+         * @param file path to file in text or binary format
+         *
+         * Binary file is mapped to memory and its tables are used in place,
+         * so processes using the same file share one physical copy. Model
+         * loaded from binary file can't use reference evaluator and can't
+         * be saved in text format. Binary file keeps quantization of tables.
+         */
         void load( const std::string &file );
 
         /**
          * @brief predict class for descriptor x
          *
          * @param x descriptor 
+         * @param voting strategy of combining one-vs-one classifiers,
+         * dag and early_exit evaluate only some of them
          *
          * @return label of predicted class
          */
-        double predict( const std::vector<double> &x );
+        double predict( const std::vector<double> &x, SvmVoting voting = SvmVoting::all ) const;
 
+        /**
+         * @brief predict class for descriptor x using workspace of caller
+         *
+         * @param x descriptor 
+         * @param workspace buffers of prediction
+         * @param voting strategy of combining one-vs-one classifiers
+         *
+         * @return label of predicted class
+         */
+        double predict( const std::vector<double> &x, IKSVMWorkspace &workspace, 
+                SvmVoting voting = SvmVoting::all ) const;
         
         /**
          * @brief predict class for all descriptors in x
          *
          * @param x vector matrix[count descriptors, descriptor dimension]
+         * @param voting strategy of combining one-vs-one classifiers
          *
          * @return vector of labels 
          */
-        std::vector<double> predictMultiple(const std::vector<double> & x);
+        std::vector<double> predictMultiple(const std::vector<double> & x,
+                SvmVoting voting = SvmVoting::all) const;
+
+        /**
+         * @brief predict class for all descriptors in x using workspace of caller
+         *
+         * @param x vector matrix[count descriptors, descriptor dimension]
+         * @param workspace buffers of prediction
+         * @param labels output labels, resized to count of descriptors
+         * @param voting strategy of combining one-vs-one classifiers
+         */
+        void predictMultiple(const std::vector<double> & x, IKSVMWorkspace &workspace,
+                std::vector<double> &labels, SvmVoting voting = SvmVoting::all) const;
 
         /**
          * @brief predict class for descriptor x and its probability outputs
@@ -207,11 +315,56 @@ class IKSVM
          *
          * @return label of predicted class and vector of probabilities for all classes
          */
-        std::pair<double, std::vector<double> > predictProbability( const std::vector<double> &x );
+        std::pair<double, std::vector<double> > predictProbability( const std::vector<double> &x ) const;
+
+        /**
+         * @brief predict class for descriptor x and its probability outputs
+         * using workspace of caller
+         *
+         * @param x descriptor 
+         * @param workspace buffers of prediction
+         * @param prob_estimates output probabilities of all classes, resized 
+         * to number of classes
+         *
+         * @return label of predicted class
+         */
+        double predictProbability( const std::vector<double> &x, IKSVMWorkspace &workspace,
+                std::vector<double> &prob_estimates ) const;
+
+        std::pair<std::vector<double>, std::vector<double> > predictProbabilityMultiple( const std::vector<double> &x ) const;
 
-        std::pair<std::vector<double>, std::vector<double> > predictProbabilityMultiple( const std::vector<double> &x );
+        /**
+         * @brief predict class for all descriptors in x and their probability 
+         * outputs using workspace of caller
+         *
+         * @param x vector matrix[count descriptors, descriptor dimension]
+         * @param workspace buffers of prediction
+         * @param labels output labels, resized to count of descriptors
+         * @param prob_estimates output probabilities, number of classes 
+         * for every descriptor
+         */
+        void predictProbabilityMultiple( const std::vector<double> &x, IKSVMWorkspace &workspace,
+                std::vector<double> &labels, std::vector<double> &prob_estimates ) const;
 
         int getNumberOfClasses() const { return nr_class_; }
+
+        /**
+         * @brief set implementation of decision function evaluation,
+         * by default the fastest one supported by cpu is used
+         *
+         * @param evaluator requested evaluator, if cpu doesn't support it,
+         * the fastest supported one below it is used
+         */
+        void setEvaluator( Evaluator evaluator );
+
+        Evaluator getEvaluator() const { return evaluator_; }
+
+        IKSVMQuantization getQuantization() const { return quantization_; }
+
+        /**
+         * @brief returns the fastest evaluator supported by cpu
+         */
+        static Evaluator getBestEvaluator();
     private:
         IKSVM( int nr_class, int features_dim, int approx_count,
                const std::vector<double> prob_A, const std::vector<double> prob_B,
@@ -231,6 +384,24 @@ class IKSVM
 
         std::vector<double> labels_;
 
+        // float copy of decision functions grouped into blocks of 8 classifiers,
+        // for every block and feature there are 8 inverted step sizes followed
+        // by 8 min samples in block_info_ and approx_count_ pairs of (value,
+        // difference to next value) for every classifier in block_values_,
+        // tables aren't modified, so copies of model share block_storage_, 
+        // that is heap buffer or mapped binary model file
+        std::shared_ptr<const void> block_storage_;
+        const float *block_info_ = nullptr;
+        const float *block_values_ = nullptr;
+        // quantized model has nullptr block_values_, for every block there are
+        // 8 scales followed by 8 offsets of whole decision function in
+        // block_scales_ and approx_count_ + 1 quantized values for every
+        // classifier and feature in block_quantized_
+        IKSVMQuantization quantization_ = IKSVMQuantization::none;
+        const float *block_scales_ = nullptr;
+        const void *block_quantized_ = nullptr;
+        Evaluator evaluator_ = getBestEvaluator();
+
         bool startsWith( const std::string &s, const std::string &start);
         std::string parse( const std::string &start, const std::string &line );
         void parseDecisionFunction(const std::string &line, std::size_t indx);
@@ -238,15 +409,28 @@ class IKSVM
 
         void saveXmlDF(pugi::xml_node & df_node, const DecisionFunction & fn);
 
-        double computeDecisionsValue( const std::vector<double> &x, 
-                std::vector<double> &decision_values );
+        int voteAll( const double *decision_values, IKSVMWorkspace &workspace ) const;
+
+        double computeProbability( const double *decision_values, IKSVMWorkspace &workspace,
+                double *prob_estimates ) const;
+
+        void buildBlockTables();
+        void quantizeBlockTables( IKSVMQuantization quantization );
+        std::size_t getBlockCount() const;
+
+        void loadBinary(const std::string &file_name);
+
+        void evalDecisionFunctions(const std::vector<double> & x,
+                IKSVMWorkspace & workspace) const;
 
-        std::vector<double> computeDecisionsValueMult(const std::vector<double> & x,
-                std::vector<double> & decision_values);
+        double evalDecisionFunction(std::size_t indx, const std::vector<double> & x, 
+                std::size_t offset) const;
 
-        double evalDecisionFunction(std::size_t indx, const std::vector<double> & x); 
+        double evalOneDecisionFunction(std::size_t indx, const std::vector<double> & x,
+                std::size_t offset) const;
 
-        double evalDecisionFunction(std::size_t indx, const std::vector<double> & x, std::size_t offset);
+        double predictWithVoting(const std::vector<double> & x, std::size_t offset,
+                SvmVoting voting, IKSVMWorkspace & workspace) const;
         
 
         const static std::string number_class_text;
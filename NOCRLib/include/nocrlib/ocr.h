@@ -82,6 +82,9 @@ struct FeatureTraits<feature::hogLongOcr>
 /**
  * @brief OCR using HOG combined with SVM with fast intersection kernel 
  * for charakter recognition
+ *
+ * Methods translate can be called by many threads at once, every thread
+ * predicts with its own IKSVMWorkspace.
  */
 class MyOCR : public AbstractOCR
 {
@@ -0,0 +1,91 @@
+/**
+ * @file region_runs.h
+ * @brief Contains class RegionRuns, run length representation of one region,
+ * which computes shape features of second stage of ER filtering directly
+ * from the region pixels.
+ */
+
+#ifndef NOCRLIB_REGION_RUNS_H
+#define NOCRLIB_REGION_RUNS_H
+
+#include <opencv2/core/core.hpp>
+
+#include <vector>
+#include <cstddef>
+
+/**
+ * @brief RegionRuns keeps pixels of region as horizontal runs sorted by row
+ *
+ * Coordinates are relative to the bounding box of region enlarged by one pixel
+ * on every side, so they are the same as coordinates in binary image of
+ * Component. Features computed from runs are equal to features computed by
+ * BackgroundMergeRule and InflectionPoints from the binary image,
+ * but neither binary image nor its copy for flood fill is created.
+ * Buffers are reused by following build.
+ */
+class RegionRuns
+{
+    public:
+        RegionRuns() : rows_(0), cols_(0) { }
+
+        /**
+         * @brief builds runs from pixels of region
+         *
+         * @param points pixels of region, region must be 4-connected
+         */
+        void build( const std::vector<cv::Point> &points );
+
+        /**
+         * @brief returns number of background pixels, that aren't 4-connected
+         * with the background outside of the region
+         */
+        std::size_t getHoleArea();
+
+        /**
+         * @brief returns area of convex hull of pixel centers, truncated
+         * to integer as in ConvexHullAreaFinder
+         */
+        std::size_t getConvexHullArea();
+
+        /**
+         * @brief stores outer border of region to \p contour, border is followed
+         * in the same order and from the same pixel as in cv::findContours
+         *
+         * @param contour output border, previous content is replaced
+         */
+        void getOuterContour( std::vector<cv::Point> &contour ) const;
+
+        int getRows() const { return rows_; }
+        int getCols() const { return cols_; }
+
+    private:
+        /// @cond
+        struct Run
+        {
+            int begin;
+            // first pixel after run
+            int end;
+        };
+        /// @endcond
+
+        int rows_;
+        int cols_;
+
+        // runs of row y are in range [row_runs_[y], row_runs_[y + 1])
+        std::vector<Run> runs_;
+        std::vector<int> row_runs_;
+
+        std::vector<int> row_offsets_;
+        std::vector<int> row_xs_;
+
+        std::vector<Run> background_;
+        std::vector<int> background_rows_;
+        std::vector<int> parents_;
+        std::vector<cv::Point> extremes_;
+        std::vector<cv::Point> hull_;
+
+        bool isInside( cv::Point p ) const;
+        int find( int run );
+};
+
+#endif /* region_runs.h */
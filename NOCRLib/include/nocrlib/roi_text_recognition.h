@@ -0,0 +1,205 @@
+/**
+ * @file roi_text_recognition.h
+ * @brief Contains class ROITextRecognition, that recognizes text only inside
+ * given regions of interest of image
+ */
+
+#ifndef NOCRLIB_ROI_TEXT_RECOGNITION_H
+#define NOCRLIB_ROI_TEXT_RECOGNITION_H
+
+#include "text_recognition.h"
+#include "extremal_region.h"
+#include "segment.h"
+#include "dictionary.h"
+#include "word_generator.h"
+#include "structures.h"
+#include "component.h"
+#include "assert.h"
+
+#include <opencv2/core/core.hpp>
+
+#include <vector>
+#include <memory>
+#include <string>
+#include <future>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <algorithm>
+
+/**
+ * @brief text recognition restricted to regions of interest of image
+ *
+ * Every region of interest is processed by ERTextDetection owned by one of
+ * the worker threads, component tree is built from the submatrix of image,
+ * so the image isn't copied and the cost depends on area of regions
+ * of interest only. Bounds of letter size are computed for the whole image.
+ * Letters are translated to coordinates of image before ocr, words
+ * are generated from letters of one region of interest.
+ *
+ * Ocr implementations keep state between calls, so the ocr phase is
+ * serialized, tree construction and word generation run concurrently.
+ * Unlike TextRecognition, input image isn't resized.
+ *
+ * This class isn't copyable and copy-assignable.
+ */
+template <typename OCR = AbstractOCR>
+class ROITextRecognition
+{
+    public:
+        /**
+         * @brief initialize object with configuration files
+         *
+         * @param first_stage_conf configuration file for first stage of ER
+         * @param second_stage_conf configuration file for second stage of ER
+         */
+        ROITextRecognition( const std::string &first_stage_conf,
+                const std::string &second_stage_conf )
+            : detection_( first_stage_conf, second_stage_conf )
+        {
+            setThreadCount( std::max( std::thread::hardware_concurrency(), 1u ) );
+        }
+
+        ROITextRecognition( const ROITextRecognition &other ) = delete;
+        ROITextRecognition& operator=( const ROITextRecognition &other ) = delete;
+
+        /**
+         * @brief recognizes words inside regions of interest of image
+         *
+         * @param image input, must be in BGR format
+         * @param rois regions of interest, they are clipped to image
+         * @param dictionary dictionary, containing words that can be recognized
+         *
+         * @return words in coordinates of \p image ordered by regions of interest,
+         * words in overlap of two regions can be found twice
+         */
+        std::vector<TranslatedWord> recognize( const cv::Mat &image,
+                const std::vector<cv::Rect> &rois,
+                const Dictionary &dictionary );
+
+        /**
+         * @brief loads ocr to be used for letter translation and nonmax suppresion
+         *
+         * @param ocr
+         */
+        void loadOcr( OCR * ocr )
+        {
+            segmentation_.loadOcr( ocr );
+        }
+
+        /**
+         * @brief set number of worker threads
+         *
+         * @param thread_count must be greater than 0
+         */
+        void setThreadCount( unsigned thread_count )
+        {
+            NOCR_ASSERT( thread_count > 0, "thread count must be greater than 0" );
+
+            workers_.clear();
+            for ( unsigned i = 0; i < thread_count; ++i )
+            {
+                workers_.emplace_back( new ERTextDetection() );
+                // regions of interest are already processed in parallel
+                workers_.back()->getTree().setSecondStageThreadCount( 1 );
+            }
+        }
+
+        /**
+         * @brief tree holding the configuration shared by all workers
+         *
+         * @return reference to ERTree
+         */
+        ERTree & getTree()
+        {
+            return detection_.getTree();
+        }
+
+    private:
+        ERTextDetection detection_;
+        std::vector< std::unique_ptr<ERTextDetection> > workers_;
+
+        // only classify is used, it is guarded by ocr_mutex_
+        Segment<ERTextDetection, OCR> segmentation_;
+        std::mutex ocr_mutex_;
+
+        std::vector<TranslatedWord> recognizeRoi( ERTextDetection &worker,
+                const cv::Mat &image, const cv::Rect &roi,
+                const Dictionary &dictionary );
+};
+
+
+template <typename OCR>
+std::vector<TranslatedWord> ROITextRecognition<OCR>::recognize(
+        const cv::Mat &image,
+        const std::vector<cv::Rect> &rois,
+        const Dictionary &dictionary )
+{
+    std::vector<cv::Rect> clipped_rois;
+    clipped_rois.reserve( rois.size() );
+    for ( const cv::Rect &roi : rois )
+    {
+        cv::Rect clipped = roi & cv::Rect( cv::Point( 0, 0 ), image.size() );
+        if ( clipped.area() > 0 )
+        {
+            clipped_rois.push_back( clipped );
+        }
+    }
+
+    std::vector< std::vector<TranslatedWord> > roi_words( clipped_rois.size() );
+    std::atomic<std::size_t> next_roi( 0 );
+
+    std::size_t worker_count = std::min( workers_.size(), clipped_rois.size() );
+    std::vector< std::future<void> > worker_futures;
+    worker_futures.reserve( worker_count );
+    for ( std::size_t w = 0; w < worker_count; ++w )
+    {
+        ERTextDetection * worker = workers_[w].get();
+        worker->getTree().shareConfiguration( detection_.getTree() );
+
+        worker_futures.push_back( std::async( std::launch::async,
+                    [this, worker, &image, &clipped_rois, &dictionary, &roi_words, &next_roi] ()
+                    {
+                        for ( std::size_t i = next_roi++; i < clipped_rois.size(); i = next_roi++ )
+                        {
+                            roi_words[i] = recognizeRoi( *worker, image,
+                                    clipped_rois[i], dictionary );
+                        }
+                    }));
+    }
+
+    for ( auto &worker_future : worker_futures )
+    {
+        worker_future.get();
+    }
+
+    std::vector<TranslatedWord> words;
+    for ( auto &words_of_roi : roi_words )
+    {
+        words.insert( words.end(), words_of_roi.begin(), words_of_roi.end() );
+    }
+
+    return words;
+}
+
+
+template <typename OCR>
+std::vector<TranslatedWord> ROITextRecognition<OCR>::recognizeRoi(
+        ERTextDetection &worker,
+        const cv::Mat &image, const cv::Rect &roi,
+        const Dictionary &dictionary )
+{
+    std::vector<Component> candidates = worker.getLetters( image, roi );
+
+    std::vector<Letter> letters;
+    {
+        std::lock_guard<std::mutex> lock( ocr_mutex_ );
+        letters = segmentation_.classify( image, candidates );
+    }
+
+    WordGenerator generator;
+    generator.initHorizontalDetection( letters, image );
+    return generator.process( dictionary );
+}
+
+#endif /* roi_text_recognition.h */
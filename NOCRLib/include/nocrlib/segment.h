@@ -23,12 +23,15 @@
 #include <ostream>
 #include <chrono>
 #include <type_traits>
+#include <iterator>
+#include <algorithm>
 
 #include "utilities.h"
 #include "component.h"
 #include "structures.h"
 #include "abstract_ocr.h"
 #include "assert.h"
+#include "deadline.h"
 
 /**
  * @brief policy class for Segment, see programming documentation for further details
@@ -83,6 +86,31 @@ struct SegmentOCRPolicy
             const std::vector<T> & objects);
 };
 
+/**
+ * @brief calls extraction of SegmentationPolicy<S> with deadline, if the policy
+ * provides it, otherwise extraction runs until its end
+ *
+ * @tparam S type of class that implements specific kind of segmentation
+ */
+template <typename S>
+struct DeadlineExtraction
+{
+    template <typename P = SegmentationPolicy<S> >
+    static auto extract( S *method_ptr, const cv::Mat &image, 
+            const Deadline &deadline, bool &truncated, int )
+        -> decltype( P::extract( method_ptr, image, deadline, truncated ) )
+    {
+        return P::extract( method_ptr, image, deadline, truncated );
+    }
+
+    template <typename P = SegmentationPolicy<S> >
+    static std::vector<typename P::MethodOutput> extract( S *method_ptr, 
+            const cv::Mat &image, const Deadline &, bool &, long )
+    {
+        return P::extract( method_ptr, image );
+    }
+};
+
 /**
  * @brief creates mask for vector of letters using non max suppresion described in
  * programming documentation
@@ -158,6 +186,23 @@ template <typename T, typename OCR> class Segment
          * @return vector of Letters 
          */
         std::vector<Letter> segment(const cv::Mat &image) 
+        {
+            TruncatedStages truncated;
+            return segment( image, Deadline(), truncated );
+        }
+
+        /**
+         * @brief segment character canditates from image until deadline
+         *
+         * @param image input image in BGR format
+         * @param deadline extraction, if the method supports it, and ocr stop 
+         * after its expiration
+         * @param truncated extraction and ocr flags are set, if the stage was cut
+         *
+         * @return vector of Letters from candidates translated before the deadline
+         */
+        std::vector<Letter> segment( const cv::Mat &image, const Deadline &deadline, 
+                TruncatedStages &truncated ) 
         {
             NOCR_ASSERT( method_ptr_ != nullptr, "pointer to method isn't loaded yet" );
             NOCR_ASSERT( ocr_ != nullptr, "pointer to ocr isn't loaded yet" );
@@ -169,24 +214,62 @@ template <typename T, typename OCR> class Segment
 #endif
 
             // extract candidates
-            std::vector<MethodOutput> letter_candidates = 
-                                SegmentationPolicy<T>::extract( method_ptr_, image );
+            std::vector<MethodOutput> letter_candidates = DeadlineExtraction<T>::
+                extract( method_ptr_, image, deadline, truncated.extraction, 0 );
 
 #if PRINT_TIME
             auto end = std::chrono::steady_clock::now();
             std::cout << "segmentation takes: " << tC(begin,end).count()
                 << " ms" << std::endl;
 #endif 
+            return classify( image, letter_candidates, deadline, truncated );
+        }
+
+        /**
+         * @brief translates already extracted character candidates by ocr
+         * and keeps the maximal ones, loaded method isn't used
+         *
+         * @param image input image, in which candidates were extracted
+         * @param letter_candidates candidates in coordinates of \p image 
+         *
+         * @return vector of Letters
+         */
+        std::vector<Letter> classify( const cv::Mat &image, 
+                std::vector<MethodOutput> &letter_candidates )
+        {
+            TruncatedStages truncated;
+            return classify( image, letter_candidates, Deadline(), truncated );
+        }
+
+        /**
+         * @brief translates character candidates by ocr until deadline
+         *
+         * @param image input image, in which candidates were extracted
+         * @param letter_candidates candidates in coordinates of \p image, 
+         * candidates not translated before the deadline are removed
+         * @param deadline ocr stops between two batches of candidates after expiration
+         * @param truncated ocr flag is set, if some candidates weren't translated
+         *
+         * @return vector of Letters
+         */
+        std::vector<Letter> classify( const cv::Mat &image, 
+                std::vector<MethodOutput> &letter_candidates,
+                const Deadline &deadline, TruncatedStages &truncated )
+        {
+            NOCR_ASSERT( ocr_ != nullptr, "pointer to ocr isn't loaded yet" );
+
             // set ocr and visual_convertor_
             ocr_->setImage( image );
+            std::vector<TranslationInfo> translations = 
+                translateCandidates( letter_candidates, deadline, truncated );
             
             if ( SegmentationPolicy<T>::k_perform_nm_suppresion )
             {
-                return nonMaxSuppresion( letter_candidates );
+                std::vector<bool> mask = getMaximal( letter_candidates, translations );
+                return extractMaximal( letter_candidates, translations, mask );
             }
 
             // no nonmax suppresion performed, return all candidates
-            std::vector<TranslationInfo> translations = SegmentOCRPolicy<OCR, MethodOutput>::translate(ocr_, letter_candidates);
             // every letter candidate is extracted because mask is set true for all 
             // of them, this means that we consider all of them to be maximal.
             std::vector<bool> mask( letter_candidates.size(), true );
@@ -197,25 +280,57 @@ template <typename T, typename OCR> class Segment
         T *method_ptr_;
         OCR * ocr_;
 
+        // number of candidates translated between two checks of deadline
+        const static std::size_t k_ocr_batch = 32;
 
-
-        std::vector<Letter> nonMaxSuppresion( std::vector<MethodOutput> &objects ) 
+        std::vector<TranslationInfo> translateCandidates( std::vector<MethodOutput> &objects, 
+                const Deadline &deadline, TruncatedStages &truncated ) 
         {
 #if PRINT_TIME
             timeCounter<std::chrono::steady_clock, 
                 std::chrono::milliseconds>  tC;
-            auto begin = std::chrono::steady_clock::now();
+            auto begin_time = std::chrono::steady_clock::now();
 #endif
-            // std::vector<TranslationInfo> translations = translate( objects );
-            std::vector<TranslationInfo> translations = SegmentOCRPolicy<OCR, MethodOutput>::translate(ocr_,
-                    objects);
+            std::vector<TranslationInfo> translations;
+            if ( deadline.isUnlimited() )
+            {
+                translations = SegmentOCRPolicy<OCR, MethodOutput>::translate( ocr_, objects );
+            }
+            else
+            {
+                translations.reserve( objects.size() );
+                std::vector<MethodOutput> batch;
+                for ( std::size_t begin = 0; begin < objects.size(); begin += k_ocr_batch )
+                {
+                    if ( deadline.expired() )
+                    {
+                        truncated.ocr = true;
+                        objects.erase( objects.begin() + begin, objects.end() );
+                        break;
+                    }
+
+                    std::size_t end = begin + k_ocr_batch;
+                    if ( end > objects.size() )
+                    {
+                        end = objects.size();
+                    }
+
+                    // candidates are moved to the batch and back
+                    batch.assign( std::make_move_iterator( objects.begin() + begin ), 
+                            std::make_move_iterator( objects.begin() + end ) );
+                    auto batch_translations = 
+                        SegmentOCRPolicy<OCR, MethodOutput>::translate( ocr_, batch );
+                    std::move( batch.begin(), batch.end(), objects.begin() + begin );
+                    translations.insert( translations.end(), 
+                            batch_translations.begin(), batch_translations.end() );
+                }
+            }
 #if PRINT_TIME
-            auto end = std::chrono::steady_clock::now();
-            std::cout << "ocr phase takes: " << tC(begin,end).count() 
+            auto end_time = std::chrono::steady_clock::now();
+            std::cout << "ocr phase takes: " << tC(begin_time,end_time).count() 
                 << " ms" << std::endl;
 #endif 
-            std::vector<bool> mask = getMaximal(objects, translations);
-            return extractMaximal(objects,translations,mask);
+            return translations;
         }
 
         std::vector<TranslationInfo> translate( std::vector<MethodOutput> &objects ) 
@@ -291,6 +291,16 @@ class Letter
             return translation_.getConfidence();
         }
 
+        /**
+         * @brief returns lexicographical information of letter
+         *
+         * @return translation and probabilities of letter
+         */
+        const TranslationInfo & getTranslationInfo() const
+        {
+            return translation_;
+        }
+
 
     private:
         CompPtr comp_ptr_;
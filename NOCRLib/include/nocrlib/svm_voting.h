@@ -0,0 +1,175 @@
+/**
+ * @file svm_voting.h
+ * @brief Contains enum SvmVoting and function svmVote, that combine
+ * one-vs-one classifiers of multiclass svm into predicted class
+ */
+
+#ifndef NOCRLIB_SVM_VOTING_H
+#define NOCRLIB_SVM_VOTING_H
+
+#include <vector>
+#include <algorithm>
+
+/**
+ * @brief strategy of combining one-vs-one classifiers
+ */
+enum class SvmVoting
+{
+    // every classifier is evaluated, class with the most votes wins
+    all,
+    // decision DAG, every classifier eliminates one class, n - 1 evaluations,
+    // predicted class can differ from voting
+    dag,
+    // voting, that stops when no class can overtake the leader,
+    // predicted class is the same as for all
+    early_exit
+};
+
+/**
+ * @brief index of one-vs-one classifier of classes \p i < \p j in order
+ * used by LibSVM and IKSVM
+ */
+inline int svmPairIndex( int i, int j, int nr_class )
+{
+    return i * ( 2 * nr_class - i - 1 ) / 2 + j - i - 1;
+}
+
+/**
+ * @brief buffers of svmVote, reused buffers keep their capacity, 
+ * so repeated voting doesn't allocate
+ */
+struct SvmVoteBuffers
+{
+    std::vector<int> votes;
+    std::vector<int> remaining;
+    std::vector<char> played;
+};
+
+/**
+ * @brief predicts class from one-vs-one classifiers
+ *
+ * @param nr_class number of classes
+ * @param voting strategy of combining classifiers
+ * @param decision functor double( int i, int j, int p ), returns decision
+ * value of classifier with index \p p for classes i < j, positive value
+ * is vote for i
+ * @param buffers buffers of voting
+ *
+ * @return index of predicted class, ties of votes are broken by lower index
+ * as in LibSVM
+ */
+template <typename Decision>
+int svmVote( int nr_class, SvmVoting voting, Decision decision, SvmVoteBuffers &buffers )
+{
+    if ( voting == SvmVoting::dag )
+    {
+        int first = 0;
+        int last = nr_class - 1;
+        while ( first < last )
+        {
+            if ( decision( first, last, svmPairIndex( first, last, nr_class ) ) > 0 )
+            {
+                --last;
+            }
+            else
+            {
+                ++first;
+            }
+        }
+        return first;
+    }
+
+    std::vector<int> &votes = buffers.votes;
+    votes.assign( nr_class, 0 );
+    auto leaderOf = [&votes] ()
+    {
+        return int( std::max_element( votes.begin(), votes.end() ) - votes.begin() );
+    };
+
+    if ( voting == SvmVoting::all )
+    {
+        int p = 0;
+        for ( int i = 0; i < nr_class; ++i )
+        {
+            for ( int j = i + 1; j < nr_class; ++j )
+            {
+                ++votes[ decision( i, j, p ) > 0 ? i : j ];
+                ++p;
+            }
+        }
+        return leaderOf();
+    }
+
+    std::vector<int> &remaining = buffers.remaining;
+    std::vector<char> &played = buffers.played;
+    remaining.assign( nr_class, nr_class - 1 );
+    played.assign( nr_class * nr_class, false );
+    auto potential = [&votes, &remaining] ( int c )
+    {
+        return votes[c] + remaining[c];
+    };
+
+    auto play = [&] ( int c )
+    {
+        // opponent with the highest potential is the most likely to take
+        // a vote from c
+        int opponent = -1;
+        for ( int o = 0; o < nr_class; ++o )
+        {
+            if ( o != c && !played[c * nr_class + o]
+                    && ( opponent < 0 || potential( o ) > potential( opponent ) ) )
+            {
+                opponent = o;
+            }
+        }
+
+        int i = std::min( c, opponent );
+        int j = std::max( c, opponent );
+        ++votes[ decision( i, j, svmPairIndex( i, j, nr_class ) ) > 0 ? i : j ];
+        --remaining[i];
+        --remaining[j];
+        played[i * nr_class + j] = played[j * nr_class + i] = true;
+    };
+
+    while ( true )
+    {
+        int leader = leaderOf();
+        if ( remaining[leader] > 0 )
+        {
+            play( leader );
+            continue;
+        }
+
+        // votes of leader are final, find class, that can still overtake it
+        int challenger = -1;
+        for ( int c = 0; c < nr_class; ++c )
+        {
+            bool can_overtake = potential( c ) > votes[leader]
+                || ( potential( c ) == votes[leader] && c < leader );
+            if ( c != leader && can_overtake
+                    && ( challenger < 0 || potential( c ) > potential( challenger ) ) )
+            {
+                challenger = c;
+            }
+        }
+
+        if ( challenger < 0 )
+        {
+            return leader;
+        }
+        play( challenger );
+    }
+}
+
+/**
+ * @brief predicts class from one-vs-one classifiers with own buffers,
+ * see svmVote above
+ */
+template <typename Decision>
+int svmVote( int nr_class, SvmVoting voting, Decision decision )
+{
+    SvmVoteBuffers buffers;
+    return svmVote( nr_class, voting, decision, buffers );
+}
+
+#endif /* svm_voting.h */
@@ -14,6 +14,9 @@
 #define NOCRLIB_TEXT_RECOGNITION_H
 
 #include <string>
+#include <vector>
+#include <memory>
+#include <algorithm>
 
 #include "segment.h"
 #include "ocr.h"
@@ -21,10 +24,27 @@
 #include "letter_equiv.h"
 #include "word_generator.h"
 #include "extremal_region.h"
+#include "deadline.h"
 
 #define SIZE 1024
 #define SAVE_WORD 1
 
+/**
+ * @brief resolution, at which TextRecognition detects text
+ */
+enum class ScalePolicy 
+{
+    // images smaller than SIZE are upscaled, output is in coordinates 
+    // of the upscaled image, which replaces the input image
+    upscale, 
+    // images are processed at native resolution
+    native, 
+    // images are upscaled only as much as needed for the expected text height 
+    // to reach min text height, at most to SIZE, output is in coordinates 
+    // of the input image
+    adaptive 
+};
+
 /**
  * @brief class for text recognition and extraction in images with dictionary 
  * using extremal region approach combined with dictionary. 
@@ -78,6 +98,21 @@ class TextRecognition
          */
         std::vector<TranslatedWord> recognize( cv::Mat &image, const Dictionary &dictionary );
 
+        /**
+         * @brief recognize and extracts words from image with given dictionary
+         * until deadline
+         *
+         * @param image input, must be in BGR format
+         * @param dict dictionary, containing words that can be recognized in image
+         * @param deadline time limit checked between stages and inside polarity 
+         * passes, ocr and dictionary traversal
+         * @param truncated stages cut by the deadline are marked
+         *
+         * @return best words found before the deadline
+         */
+        std::vector<TranslatedWord> recognize( cv::Mat &image, const Dictionary &dictionary,
+                const Deadline &deadline, TruncatedStages &truncated );
+
         /**
          * @brief loads image from \p image_path and recognize and extracts words with given dictionary
          * using the algorithm described in my bachelor thesis
@@ -91,6 +126,15 @@ class TextRecognition
          * about detected words.
          */
         std::vector<TranslatedWord> recognize( const std::string &image_path, const Dictionary &dictionary );
+
+        /**
+         * @brief loads image from \p image_path and recognize words until deadline,
+         * see recognize( cv::Mat &, const Dictionary &, const Deadline &, TruncatedStages & ) 
+         *
+         * @throws FileNotFoundException if image does't exist
+         */
+        std::vector<TranslatedWord> recognize( const std::string &image_path, const Dictionary &dictionary,
+                const Deadline &deadline, TruncatedStages &truncated );
                 
 
         template <typename ... ARGS>
@@ -114,6 +158,17 @@ class TextRecognition
             segmentation_.loadOcr( ocr );
         }
 
+        /**
+         * @brief returns extraction method used for segmentation
+         *
+         * @return raw pointer to extraction method, nullptr if
+         * no method has been loaded yet
+         */
+        EXTRACTION * getExtraction()
+        {
+            return extraction_;
+        }
+
         void loadExtraction(EXTRACTION * extraction )
         {
             if (extraction_allocated_)
@@ -124,6 +179,38 @@ class TextRecognition
             segmentation_.loadMethod(extraction_);
         }
 
+        /**
+         * @brief set resolution, at which text is detected, see ScalePolicy
+         *
+         * @param scale_policy default is ScalePolicy::upscale
+         */
+        void setScalePolicy( ScalePolicy scale_policy )
+        {
+            scale_policy_ = scale_policy;
+        }
+
+        /**
+         * @brief set height of the smallest text expected in input images
+         *
+         * @param expected_text_height height in pixels of input image, 
+         * 0 means unknown, then ScalePolicy::adaptive upscales as ScalePolicy::upscale
+         */
+        void setExpectedTextHeight( int expected_text_height )
+        {
+            expected_text_height_ = expected_text_height;
+        }
+
+        /**
+         * @brief set the smallest text height, that is reliably detected 
+         * by extraction method
+         *
+         * @param min_text_height height in pixels of processed image
+         */
+        void setMinTextHeight( int min_text_height )
+        {
+            min_text_height_ = min_text_height;
+        }
+
         /**
          * @brief enable/disable showing extracted letters
          *
@@ -153,8 +240,20 @@ class TextRecognition
 
         Resizer resizer_;
 
+        ScalePolicy scale_policy_ = ScalePolicy::upscale;
+        int expected_text_height_ = 0;
+        int min_text_height_ = 16;
+
         cv::Mat loadImage( const std::string &image_path );
 
+        std::vector<TranslatedWord> recognizeScaled( const cv::Mat &image, 
+                const Dictionary &dictionary, const Deadline &deadline, 
+                TruncatedStages &truncated );
+
+        double getAdaptiveScale( const cv::Mat &image ) const;
+        static TranslatedWord scaleWord( const TranslatedWord &word, double factor );
+        static Letter scaleLetter( const Letter &letter, double factor );
+
         bool show_letters_, show_words_;
         void showLetters( const std::vector<Letter> &letters, const cv::Mat &image );
         void showWords( const std::vector<TranslatedWord> &words, const cv::Mat &image );
@@ -167,12 +266,53 @@ std::vector<TranslatedWord> TextRecognition<EXTRACTION, OCR>::recognize(
         cv::Mat &image, 
         const Dictionary &dictionary )
 {
-    if ( image.rows < SIZE && image.cols < SIZE )
+    TruncatedStages truncated;
+    return recognize( image, dictionary, Deadline(), truncated );
+}
+
+
+template <typename EXTRACTION, typename OCR>
+std::vector<TranslatedWord> TextRecognition<EXTRACTION, OCR>::recognize( 
+        cv::Mat &image, 
+        const Dictionary &dictionary,
+        const Deadline &deadline,
+        TruncatedStages &truncated )
+{
+    if ( scale_policy_ == ScalePolicy::adaptive )
+    {
+        double scale = getAdaptiveScale( image );
+        if ( scale > 1 )
+        {
+            cv::Mat scaled_image;
+            cv::resize( image, scaled_image, 
+                    cv::Size( image.cols * scale, image.rows * scale ) );
+
+            auto words = recognizeScaled( scaled_image, dictionary, deadline, truncated );
+            for ( auto &word : words )
+            {
+                word = scaleWord( word, (double) image.cols / scaled_image.cols );
+            }
+            return words;
+        }
+    }
+    else if ( scale_policy_ == ScalePolicy::upscale
+            && image.rows < SIZE && image.cols < SIZE )
     {
         image = resizer_.resizeKeepAspectRatio(image);
     }
 
-    auto letters = segmentation_.segment( image );
+    return recognizeScaled( image, dictionary, deadline, truncated );
+}
+
+
+template <typename EXTRACTION, typename OCR>
+std::vector<TranslatedWord> TextRecognition<EXTRACTION, OCR>::recognizeScaled( 
+        const cv::Mat &image, 
+        const Dictionary &dictionary,
+        const Deadline &deadline,
+        TruncatedStages &truncated )
+{
+    auto letters = segmentation_.segment( image, deadline, truncated );
 
     if ( show_letters_ )
     {
@@ -180,11 +320,11 @@ std::vector<TranslatedWord> TextRecognition<EXTRACTION, OCR>::recognize(
     }
 
     WordGenerator generator;
-
-    auto all_words = dictionary.getAllWords();
+    generator.setDeadline( deadline );
 
     generator.initHorizontalDetection( letters, image );
     vector<TranslatedWord> words = generator.process( dictionary ); 
+    truncated.word_generation = generator.isTruncated();
 
     if ( show_words_ )
     {
@@ -204,6 +344,86 @@ std::vector<TranslatedWord> TextRecognition<EXTRACTION, OCR>::recognize
 }
 
 
+template <typename EXTRACTION, typename OCR>
+std::vector<TranslatedWord> TextRecognition<EXTRACTION, OCR>::recognize
+    ( const std::string &image_path, const Dictionary &dictionary,
+      const Deadline &deadline, TruncatedStages &truncated )
+{
+    cv::Mat input_image = loadImage( image_path );
+    return recognize( input_image, dictionary, deadline, truncated );
+}
+
+
+template <typename EXTRACTION, typename OCR>
+double TextRecognition<EXTRACTION, OCR>::getAdaptiveScale( const cv::Mat &image ) const
+{
+    if ( image.rows >= SIZE || image.cols >= SIZE )
+    {
+        return 1;
+    }
+
+    // scale of ScalePolicy::upscale is the upper bound
+    double max_scale = (double) SIZE / std::max( image.rows, image.cols );
+    if ( expected_text_height_ <= 0 )
+    {
+        return max_scale;
+    }
+
+    double scale = (double) min_text_height_ / expected_text_height_;
+    return std::min( max_scale, std::max( 1.0, scale ) );
+}
+
+
+template <typename EXTRACTION, typename OCR>
+TranslatedWord TextRecognition<EXTRACTION, OCR>::scaleWord( const TranslatedWord &word, 
+        double factor )
+{
+    cv::Rect rect = word.visual_information_.getRectangle();
+    Word visual_information( cv::Rect( rect.x * factor, rect.y * factor, 
+                std::max( 1.0, rect.width * factor ), std::max( 1.0, rect.height * factor ) ) );
+
+    for ( const Letter &letter : word.visual_information_.getLetters() )
+    {
+        visual_information.addLetter( scaleLetter( letter, factor ) );
+    }
+
+    return TranslatedWord( visual_information, word.translation_ );
+}
+
+
+template <typename EXTRACTION, typename OCR>
+Letter TextRecognition<EXTRACTION, OCR>::scaleLetter( const Letter &letter, double factor )
+{
+    auto less_point = [] ( const cv::Point &a, const cv::Point &b )
+    {
+        return a.y < b.y || ( a.y == b.y && a.x < b.x );
+    };
+
+    // several pixels of scaled image fall to one pixel of input image
+    std::vector<cv::Point> points = letter.getPoints();
+    for ( cv::Point &p : points )
+    {
+        p = cv::Point( p.x * factor, p.y * factor );
+    }
+    std::sort( points.begin(), points.end(), less_point );
+    points.erase( std::unique( points.begin(), points.end() ), points.end() );
+
+    auto component = std::make_shared<Component>();
+    component->reserve( points.size() );
+    for ( const cv::Point &p : points )
+    {
+        component->addPointWithoutUpdatingSize( p );
+    }
+
+    component->setLeft( letter.getLeftBorder() * factor );
+    component->setRight( letter.getRightBorder() * factor );
+    component->setUpper( letter.getUpperBorder() * factor );
+    component->setLower( letter.getLowerBorder() * factor );
+
+    return Letter( component, letter.getTranslationInfo() );
+}
+
+
 template <typename EXTRACTION, typename OCR>
 cv::Mat TextRecognition<EXTRACTION, OCR>::loadImage( const std::string &image_path )
 {
@@ -0,0 +1,219 @@
+/**
+ * @file union_find_tree_builder.h
+ * @brief Contains quasi linear algorithm proposed by Najman and Couprie
+ * for computing component tree from domain bitmap using union find
+ * over pixels sorted by gray level.
+ *
+ */
+
+#ifndef NOCRLIB_UNION_FIND_TREE_BUILDER_H
+#define NOCRLIB_UNION_FIND_TREE_BUILDER_H
+
+#include <opencv2/core/core.hpp>
+
+#include <vector>
+
+#include "component_tree_builder.h"
+
+/**
+ * @brief UnionFindTreeBuilder encapsulates algorithm proposed by
+ * Najman and Couprie for building component tree
+ *
+ * @tparam E type of class, that implements structural steps of
+ * building the tree and from which we get the domain bitmap.
+ *
+ * Pixels are sorted by gray level with counting sort and processed
+ * from the lowest level. Every processed pixel is united with already
+ * processed neighbours, components are tracked by union find with
+ * union by rank and path halving. Class E is driven through the same
+ * steps as in ComponentTreeBuilder: createNode, accumulate and merge.
+ * Two regions of the same level, that meet at plateau, are united by
+ * method join of class E, which merges the regions without creating
+ * new node in the tree.
+ */
+template < typename E >
+class UnionFindTreeBuilder
+{
+    public:
+        typedef typename ComponentTreePolicy<E>::NodeId NodeId;
+
+        /**
+         * @brief loads class E, that will take care of structural part
+         * of building the component tree
+         *
+         * @param extraction raw pointer to the instance of class Extraction
+         */
+        UnionFindTreeBuilder( E *extraction )
+            : extraction_( extraction )
+        {
+        }
+
+        /**
+         * @brief method builds component tree
+         *
+         * @return root node builded component tree
+         *
+         * Output is root of component tree. UnionFindTreeBuilder is not
+         * resposible for deallocating the ComponentTree, that is an user
+         * responsibility.
+         */
+        NodeId buildTree()
+        {
+            cv::Mat domain_bitmap = extraction_->getDomain();
+            int init_pixel;
+            ComponentTreePolicy<E>::init( domain_bitmap, border_pixels_, &init_pixel );
+            // init pixel is only start of flooding, it isn't border pixel
+            border_pixels_[init_pixel] = false;
+
+            const uchar* image_data = domain_bitmap.data;
+            cols_ = domain_bitmap.cols;
+            int size = domain_bitmap.rows * domain_bitmap.cols;
+
+            sortPixels( image_data, size );
+            parents_.assign( size, -1 );
+            ranks_.assign( size, 0 );
+            nodes_.assign( size, NodeId() );
+
+            NodeId last = NodeId();
+            for ( int code : sorted_pixels_ )
+            {
+                int level = image_data[code];
+                int root = code;
+                parents_[code] = code;
+
+                NodeId node = NodeId();
+                bool has_node = false;
+                for ( int i = 0; i < 4; ++i )
+                {
+                    int ncode = getNeighbour( code, i );
+                    // border pixel or pixel with higher level
+                    if ( parents_[ncode] < 0 )
+                    {
+                        continue;
+                    }
+
+                    int nroot = find( ncode );
+                    if ( nroot == root )
+                    {
+                        continue;
+                    }
+
+                    NodeId neighbour_node = nodes_[nroot];
+                    if ( ComponentTreePolicy<E>::getLevel( extraction_, neighbour_node ) < level )
+                    {
+                        // neighbour region is complete, it becomes child
+                        if ( !has_node )
+                        {
+                            node = extraction_->createNode( getPoint(code), level );
+                            has_node = true;
+                        }
+                        extraction_->merge( neighbour_node, node );
+                    }
+                    else if ( !has_node )
+                    {
+                        node = neighbour_node;
+                        has_node = true;
+                    }
+                    else
+                    {
+                        // two parts of the same plateau
+                        extraction_->join( neighbour_node, node );
+                    }
+
+                    root = link( root, nroot );
+                }
+
+                if ( !has_node )
+                {
+                    node = extraction_->createNode( getPoint(code), level );
+                }
+
+                nodes_[root] = node;
+                extraction_->accumulate( node, code );
+                last = node;
+            }
+
+            // domain is connected, last node contains all pixels
+            ComponentTreePolicy<E>::setRoot( last, extraction_ );
+            return last;
+        }
+
+    private:
+        E *extraction_;
+
+        int cols_;
+        std::vector<bool> border_pixels_;
+        std::vector<int> sorted_pixels_;
+        std::vector<int> parents_;
+        std::vector<int> ranks_;
+        std::vector<NodeId> nodes_;
+
+        void sortPixels( const uchar *image_data, int size )
+        {
+            std::vector<int> offsets( 257, 0 );
+            for ( int code = 0; code < size; ++code )
+            {
+                if ( !border_pixels_[code] )
+                {
+                    ++offsets[ image_data[code] + 1 ];
+                }
+            }
+
+            for ( int i = 1; i < 257; ++i )
+            {
+                offsets[i] += offsets[i - 1];
+            }
+
+            sorted_pixels_.resize( offsets[256] );
+            for ( int code = 0; code < size; ++code )
+            {
+                if ( !border_pixels_[code] )
+                {
+                    sorted_pixels_[ offsets[ image_data[code] ]++ ] = code;
+                }
+            }
+        }
+
+        int find( int code )
+        {
+            while ( parents_[code] != code )
+            {
+                parents_[code] = parents_[ parents_[code] ];
+                code = parents_[code];
+            }
+            return code;
+        }
+
+        int link( int a, int b )
+        {
+            if ( ranks_[a] < ranks_[b] )
+            {
+                std::swap( a, b );
+            }
+
+            parents_[b] = a;
+            if ( ranks_[a] == ranks_[b] )
+            {
+                ++ranks_[a];
+            }
+            return a;
+        }
+
+        int getNeighbour( int code, int index ) const
+        {
+            switch( index )
+            {
+                case 0: return code - cols_;
+                case 1: return code - 1;
+                case 2: return code + 1;
+                default: return code + cols_;
+            }
+        }
+
+        cv::Point getPoint( int pixel_code ) const
+        {
+            return cv::Point( pixel_code % cols_, pixel_code / cols_);
+        }
+};
+
+#endif /* union_find_tree_builder.h */
@@ -218,9 +218,21 @@ class helper
         }
 
         static std::vector<bool> getAccesibilityMaskWithNegativeBorder( const cv::Mat &bitmap )
+        {
+            std::vector<bool> out;
+            setAccesibilityMaskWithNegativeBorder( bitmap, out );
+            return out; 
+        }
+
+        /**
+         * @brief fills \p out with accessibility mask of \p bitmap,
+         * capacity of \p out is reused
+         */
+        static void setAccesibilityMaskWithNegativeBorder( const cv::Mat &bitmap, 
+                std::vector<bool> &out )
         {
             const int size = bitmap.rows * bitmap.cols;
-            std::vector<bool> out( size, false ); 
+            out.assign( size, false ); 
             //set false first row
             for( int i = 0; i < bitmap.cols; ++i ) 
             {
@@ -241,8 +253,6 @@ class helper
             {
                 out[i] = true;
             }
-
-            return out; 
         }
 };
 
@@ -424,6 +434,36 @@ class Resizer
         double  last_scale_;
 };
 
+/**
+ * @brief replaces overlapping rectangles by their bounding rectangle,
+ * until all rectangles are disjoint
+ */
+inline void mergeOverlappingRects( std::vector<cv::Rect> &rects )
+{
+    bool merged = true;
+    while ( merged )
+    {
+        merged = false;
+        for ( std::size_t i = 0; i < rects.size(); ++i )
+        {
+            for ( std::size_t j = i + 1; j < rects.size(); )
+            {
+                if ( ( rects[i] & rects[j] ).area() > 0 )
+                {
+                    rects[i] |= rects[j];
+                    rects[j] = rects.back();
+                    rects.pop_back();
+                    merged = true;
+                }
+                else
+                {
+                    ++j;
+                }
+            }
+        }
+    }
+}
+
 inline double angle(cv::Point a, cv::Point b, cv::Point c)
 {
     cv::Point v1 = a - b;
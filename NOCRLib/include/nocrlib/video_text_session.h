@@ -0,0 +1,338 @@
+/**
+ * @file video_text_session.h
+ * @brief Contains class VideoTextSession, that recognizes text in sequence
+ * of video frames and recomputes only changed parts of frame
+ */
+
+#ifndef NOCRLIB_VIDEO_TEXT_SESSION_H
+#define NOCRLIB_VIDEO_TEXT_SESSION_H
+
+#include "text_recognition.h"
+#include "extremal_region.h"
+#include "segment.h"
+#include "dictionary.h"
+#include "word_generator.h"
+#include "structures.h"
+#include "component.h"
+#include "utilities.h"
+#include "assert.h"
+
+#include <opencv2/core/core.hpp>
+#include <opencv2/imgproc/imgproc.hpp>
+
+#include <vector>
+#include <memory>
+#include <string>
+#include <set>
+#include <algorithm>
+
+/**
+ * @brief text recognition in video, that reuses results of previous frame
+ *
+ * Frame is divided into square tiles. Tile is dirty, if enough of its pixels
+ * differ from the last frame, in which the tile was processed, so slow
+ * changes are accumulated until they are detected. Dirty tiles are dilated
+ * by margin and merged into regions, letters are extracted and translated
+ * by ocr only in these regions, letters of previous frame not touching
+ * dirty tiles are reused. Words are generated again only from letters near
+ * the regions and from letters of previous words touching them, other
+ * words are reused.
+ *
+ * Letters larger than margin can be cut by the region border. Frames
+ * aren't resized. First frame, frame of different size and change of
+ * dictionary lead to processing of the whole frame.
+ *
+ * This class isn't copyable and copy-assignable.
+ */
+template <typename OCR = AbstractOCR>
+class VideoTextSession
+{
+    public:
+        /**
+         * @brief initialize object with configuration files
+         *
+         * @param first_stage_conf configuration file for first stage of ER
+         * @param second_stage_conf configuration file for second stage of ER
+         */
+        VideoTextSession( const std::string &first_stage_conf,
+                const std::string &second_stage_conf )
+            : detection_( first_stage_conf, second_stage_conf )
+        {
+        }
+
+        VideoTextSession( const VideoTextSession &other ) = delete;
+        VideoTextSession& operator=( const VideoTextSession &other ) = delete;
+
+        /**
+         * @brief recognizes words in next frame of sequence
+         *
+         * @param frame input frame, must be in BGR format
+         * @param dictionary dictionary, containing words that can be recognized
+         *
+         * @return words in frame
+         */
+        std::vector<TranslatedWord> processFrame( const cv::Mat &frame,
+                const Dictionary &dictionary );
+
+        /**
+         * @brief forgets previous frame, next frame is processed as whole
+         */
+        void reset()
+        {
+            previous_gray_.release();
+            letters_.clear();
+            words_.clear();
+            dictionary_ = nullptr;
+        }
+
+        /**
+         * @brief loads ocr to be used for letter translation and nonmax suppresion
+         *
+         * @param ocr
+         */
+        void loadOcr( OCR * ocr )
+        {
+            segmentation_.loadOcr( ocr );
+        }
+
+        /**
+         * @brief set size of square tiles
+         *
+         * @param tile_size must be greater than 0
+         */
+        void setTileSize( int tile_size )
+        {
+            NOCR_ASSERT( tile_size > 0, "tile size must be greater than 0" );
+            tile_size_ = tile_size;
+            reset();
+        }
+
+        /**
+         * @brief set when the tile is dirty
+         *
+         * @param pixel_difference pixel is changed, if its gray level differs
+         * by more than \p pixel_difference
+         * @param changed_ratio tile is dirty, if ratio of changed pixels is greater
+         */
+        void setChangeThreshold( int pixel_difference, double changed_ratio )
+        {
+            pixel_difference_ = pixel_difference;
+            changed_ratio_ = changed_ratio;
+        }
+
+        /**
+         * @brief set dilation of dirty tiles in pixels
+         *
+         * @param margin letters higher than margin can be cut
+         */
+        void setMargin( int margin )
+        {
+            margin_ = margin;
+        }
+
+        /**
+         * @brief number of dirty tiles in the last frame
+         */
+        std::size_t getDirtyTiles() const
+        {
+            return dirty_tiles_.size();
+        }
+
+        /**
+         * @brief number of all tiles in the last frame
+         */
+        std::size_t getTiles() const
+        {
+            return tile_count_;
+        }
+
+        /**
+         * @brief detection holding the configuration
+         *
+         * @return reference to ERTextDetection
+         */
+        ERTextDetection & getDetection()
+        {
+            return detection_;
+        }
+
+    private:
+        ERTextDetection detection_;
+        // only classify is used
+        Segment<ERTextDetection, OCR> segmentation_;
+
+        int tile_size_ = 64;
+        int pixel_difference_ = 24;
+        double changed_ratio_ = 0.002;
+        int margin_ = 32;
+
+        // gray levels of the last frame, in which the tile was dirty
+        cv::Mat previous_gray_;
+        cv::Mat changed_;
+        const Dictionary *dictionary_ = nullptr;
+
+        std::vector<Letter> letters_;
+        std::vector<TranslatedWord> words_;
+
+        std::vector<cv::Rect> dirty_tiles_;
+        std::size_t tile_count_ = 0;
+
+        void findDirtyTiles( const cv::Mat &gray, bool whole_frame );
+
+        std::vector<Letter> extractLetters( const cv::Mat &frame,
+                const std::vector<cv::Rect> &regions );
+
+        static bool intersectsAny( const cv::Rect &rect, const std::vector<cv::Rect> &rects );
+};
+
+
+template <typename OCR>
+std::vector<TranslatedWord> VideoTextSession<OCR>::processFrame(
+        const cv::Mat &frame, const Dictionary &dictionary )
+{
+    cv::Mat gray;
+    cv::cvtColor( frame, gray, CV_BGR2GRAY );
+
+    bool whole_frame = previous_gray_.empty() || previous_gray_.size() != gray.size()
+        || dictionary_ != &dictionary;
+    if ( whole_frame )
+    {
+        letters_.clear();
+        words_.clear();
+        // all tiles are dirty, they are copied in findDirtyTiles
+        previous_gray_.create( gray.size(), gray.type() );
+    }
+    dictionary_ = &dictionary;
+
+    findDirtyTiles( gray, whole_frame );
+    if ( dirty_tiles_.empty() )
+    {
+        return words_;
+    }
+
+    std::vector<cv::Rect> regions;
+    regions.reserve( dirty_tiles_.size() );
+    cv::Rect frame_rect( cv::Point( 0, 0 ), frame.size() );
+    for ( const cv::Rect &tile : dirty_tiles_ )
+    {
+        regions.push_back( cv::Rect( tile.x - margin_, tile.y - margin_,
+                    tile.width + 2 * margin_, tile.height + 2 * margin_ ) & frame_rect );
+    }
+    mergeOverlappingRects( regions );
+
+    // letters touching dirty tiles are replaced by letters of this frame
+    std::vector<Letter> letters;
+    for ( const Letter &letter : letters_ )
+    {
+        if ( !intersectsAny( letter.getRectangle(), dirty_tiles_ ) )
+        {
+            letters.push_back( letter );
+        }
+    }
+    std::size_t reused_letters = letters.size();
+
+    auto new_letters = extractLetters( frame, regions );
+    letters.insert( letters.end(), new_letters.begin(), new_letters.end() );
+
+    // words touching regions are generated again with all their letters
+    std::vector<TranslatedWord> words;
+    std::set<const Component *> regenerated;
+    for ( const TranslatedWord &word : words_ )
+    {
+        if ( !intersectsAny( word.visual_information_.getRectangle(), regions ) )
+        {
+            words.push_back( word );
+            continue;
+        }
+
+        for ( const Letter &letter : word.visual_information_.getLetters() )
+        {
+            regenerated.insert( letter.getPtrComp().get() );
+        }
+    }
+
+    std::vector<Letter> generator_letters( new_letters );
+    for ( std::size_t i = 0; i < reused_letters; ++i )
+    {
+        const Letter &letter = letters[i];
+        if ( intersectsAny( letter.getRectangle(), regions )
+                || regenerated.count( letter.getPtrComp().get() ) )
+        {
+            generator_letters.push_back( letter );
+        }
+    }
+
+    WordGenerator generator;
+    generator.initHorizontalDetection( generator_letters, frame );
+    auto new_words = generator.process( dictionary );
+    words.insert( words.end(), new_words.begin(), new_words.end() );
+
+    letters_.swap( letters );
+    words_ = words;
+    return words_;
+}
+
+
+template <typename OCR>
+void VideoTextSession<OCR>::findDirtyTiles( const cv::Mat &gray, bool whole_frame )
+{
+    if ( !whole_frame )
+    {
+        cv::absdiff( gray, previous_gray_, changed_ );
+        cv::threshold( changed_, changed_, pixel_difference_, 255, cv::THRESH_BINARY );
+    }
+
+    dirty_tiles_.clear();
+    tile_count_ = 0;
+    cv::Rect frame_rect( cv::Point( 0, 0 ), gray.size() );
+    for ( int y = 0; y < gray.rows; y += tile_size_ )
+    {
+        for ( int x = 0; x < gray.cols; x += tile_size_ )
+        {
+            cv::Rect tile = cv::Rect( x, y, tile_size_, tile_size_ ) & frame_rect;
+            ++tile_count_;
+            if ( whole_frame
+                    || cv::countNonZero( changed_( tile ) ) > changed_ratio_ * tile.area() )
+            {
+                dirty_tiles_.push_back( tile );
+                // unchanged tiles keep older levels, so slow changes add up
+                cv::Mat previous_tile = previous_gray_( tile );
+                gray( tile ).copyTo( previous_tile );
+            }
+        }
+    }
+}
+
+
+template <typename OCR>
+std::vector<Letter> VideoTextSession<OCR>::extractLetters( const cv::Mat &frame,
+        const std::vector<cv::Rect> &regions )
+{
+    std::vector<Component> candidates;
+    for ( const cv::Rect &region : regions )
+    {
+        for ( const Component &letter : detection_.getLetters( frame, region ) )
+        {
+            // letters in margin only are reused from previous frame
+            if ( intersectsAny( letter.rectangle(), dirty_tiles_ ) )
+            {
+                candidates.push_back( letter );
+            }
+        }
+    }
+
+    return segmentation_.classify( frame, candidates );
+}
+
+
+template <typename OCR>
+bool VideoTextSession<OCR>::intersectsAny( const cv::Rect &rect,
+        const std::vector<cv::Rect> &rects )
+{
+    return std::any_of( rects.begin(), rects.end(), [&rect] ( const cv::Rect &other )
+            {
+                return ( rect & other ).area() > 0;
+            });
+}
+
+#endif /* video_text_session.h */
@@ -16,6 +16,7 @@
 #include "dictionary.h"
 #include "trie_node.h"
 #include "word_deformation.h"
+#include "deadline.h"
 
 
 #include <vector>
@@ -130,6 +131,25 @@ class WordGenerator
         {
             space_stddev_factor_ = space_stddev_factor;
         }
+
+        /**
+         * @brief set deadline of dictionary traversal in process
+         *
+         * @param deadline after expiration no other dictionary node is visited
+         * and best words found so far are returned
+         */
+        void setDeadline( const Deadline &deadline )
+        {
+            deadline_ = deadline;
+        }
+
+        /**
+         * @brief returns true, if last call of process was cut by the deadline
+         */
+        bool isTruncated() const
+        {
+            return truncated_;
+        }
         
     private:
 
@@ -250,6 +270,9 @@ class WordGenerator
         // std::map<double, WordRecord> detected_words_;
         std::vector<WordRecord> detected_words_;
 
+        Deadline deadline_;
+        bool truncated_ = false;
+
         double computeDeformationCost( int i, int j );
 
         template <typename EdgeEval> 
@@ -312,6 +335,7 @@ class WordGenerator
 
 //===================================traversing dictionary trie ===========================
         void traverse( TrieNode *root, std::string &word );
+        bool isExpired();
         
         void updateTables(char current_letter);
 
@@ -51,6 +51,164 @@
 
 using namespace std;
 
+bool FlatBoost::compile( CvBoost &boost, int max_depth )
+{
+    clear();
+
+    CvSeq *weak_predictors = boost.get_weak_predictors();
+    const CvDTreeTrainData *data = boost.get_data();
+    if ( weak_predictors == nullptr || data == nullptr )
+    {
+        return false;
+    }
+
+    vector<const CvDTreeNode*> roots;
+    CvSeqReader reader;
+    cvStartReadSeq( weak_predictors, &reader );
+    for ( int i = 0; i < weak_predictors->total; ++i )
+    {
+        CvBoostTree *tree;
+        CV_READ_SEQ_ELEM( tree, reader );
+        roots.push_back( tree->get_root() );
+        depth_ = std::max( depth_, getDepth( roots.back() ) );
+    }
+
+    if ( depth_ > max_depth )
+    {
+        clear();
+        return false;
+    }
+
+    tree_count_ = roots.size();
+    int inner_count = ( 1 << depth_ ) - 1;
+    vars_.assign( tree_count_ * inner_count, 0 );
+    thresholds_.assign( tree_count_ * inner_count, 0 );
+    leaves_.assign( tree_count_ * ( inner_count + 1 ), 0 );
+
+    const int *var_type = data->var_type->data.i;
+    for ( int t = 0; t < tree_count_; ++t )
+    {
+        if ( !flattenNode( roots[t], var_type, 0, 0, t ) )
+        {
+            clear();
+            return false;
+        }
+    }
+
+    return true;
+}
+
+int FlatBoost::getDepth( const CvDTreeNode *node )
+{
+    if ( node->left == nullptr )
+    {
+        return 0;
+    }
+
+    return 1 + std::max( getDepth( node->left ), getDepth( node->right ) );
+}
+
+bool FlatBoost::flattenNode( const CvDTreeNode *node, const int *var_type, 
+        int index, int depth, int tree )
+{
+    int inner_count = ( 1 << depth_ ) - 1;
+    if ( depth == depth_ )
+    {
+        leaves_[ tree * ( inner_count + 1 ) + index - inner_count ] = node->value;
+        return true;
+    }
+
+    int position = tree * inner_count + index;
+    if ( node->left == nullptr )
+    {
+        // leaf above the maximal depth, both subtrees end in it
+        vars_[position] = 0;
+        thresholds_[position] = 0;
+        return flattenNode( node, var_type, 2 * index + 1, depth + 1, tree )
+            && flattenNode( node, var_type, 2 * index + 2, depth + 1, tree );
+    }
+
+    const CvDTreeSplit *split = node->split;
+    if ( var_type[ split->condensed_idx ] >= 0 )
+    {
+        // categorical split
+        return false;
+    }
+
+    vars_[position] = split->var_idx;
+    thresholds_[position] = split->ord.c;
+
+    const CvDTreeNode *less_equal = split->inversed ? node->right : node->left;
+    const CvDTreeNode *greater = split->inversed ? node->left : node->right;
+    return flattenNode( less_equal, var_type, 2 * index + 1, depth + 1, tree )
+        && flattenNode( greater, var_type, 2 * index + 2, depth + 1, tree );
+}
+
+void FlatBoost::clear()
+{
+    depth_ = 0;
+    tree_count_ = 0;
+    vars_.clear();
+    thresholds_.clear();
+    leaves_.clear();
+}
+
+// =================================================================
+
+double svmPredictVoting( const svm_model *model, const svm_node *x, SvmVoting voting )
+{
+    if ( voting == SvmVoting::all
+            || ( model->param.svm_type != C_SVC && model->param.svm_type != NU_SVC ) )
+    {
+        return svm_predict( model, x );
+    }
+
+    int nr_class = model->nr_class;
+    vector<int> start( nr_class, 0 );
+    for ( int i = 1; i < nr_class; ++i )
+    {
+        start[i] = start[i - 1] + model->nSV[i - 1];
+    }
+
+    vector<double> kvalue( model->l );
+    vector<char> computed( nr_class, false );
+    auto computeKernels = [&] ( int c )
+    {
+        if ( !computed[c] )
+        {
+            for ( int k = start[c]; k < start[c] + model->nSV[c]; ++k )
+            {
+                kvalue[k] = svm_k_function( x, model->SV[k], &model->param );
+            }
+            computed[c] = true;
+        }
+    };
+
+    // sums are computed in the same order as in svm_predict_values
+    int winner = svmVote( nr_class, voting, [&] ( int i, int j, int p )
+            {
+                computeKernels( i );
+                computeKernels( j );
+
+                double sum = 0;
+                const double *coef1 = model->sv_coef[j - 1];
+                const double *coef2 = model->sv_coef[i];
+                for ( int k = 0; k < model->nSV[i]; ++k )
+                {
+                    sum += coef1[start[i] + k] * kvalue[start[i] + k];
+                }
+                for ( int k = 0; k < model->nSV[j]; ++k )
+                {
+                    sum += coef2[start[j] + k] * kvalue[start[j] + k];
+                }
+                return sum - model->rho[p];
+            });
+
+    return model->label[winner];
+}
+
+// =================================================================
+
 svm_model* LibSVMTrainBridge::train( const cv::Mat &train_data, const cv::Mat &labels, 
         svm_parameter *params )
 {
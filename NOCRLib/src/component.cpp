@@ -142,6 +142,23 @@ std::vector<cv::Point> getPerimeterPoints
     return output; 
 }
 
+Component translated( const Component &c, const cv::Point &offset )
+{
+    Component output;
+    output.reserve( c.size() );
+    for ( const cv::Point &p : c.getPoints() )
+    {
+        output.addPointWithoutUpdatingSize( p + offset );
+    }
+
+    output.setLeft( c.getLeft() + offset.x );
+    output.setRight( c.getRight() + offset.x );
+    output.setUpper( c.getUpper() + offset.y );
+    output.setLower( c.getLower() + offset.y );
+
+    return output;
+}
+
 static bool isInsideBounds( const cv::Point &p, const cv::Size &bounds )
 {
     return ( p.x >= 0 && p.y >= 0 && p.x < bounds.width && p.y < bounds.height );
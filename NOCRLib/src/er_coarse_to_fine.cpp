@@ -0,0 +1,106 @@
+/*
+ * Implementation of methods and classes declared in er_coarse_to_fine.h
+ *
+ * Compiler: g++ 4.8.3
+ */
+#include "../include/nocrlib/er_coarse_to_fine.h"
+#include "../include/nocrlib/assert.h"
+#include "../include/nocrlib/utilities.h"
+
+#include <opencv2/core/core.hpp>
+#include <opencv2/imgproc/imgproc.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <tuple>
+
+using namespace std;
+
+ERCoarseToFineDetection::ERCoarseToFineDetection( const std::string &first_stage_conf,
+        const std::string &second_stage_conf )
+    : detection_( first_stage_conf, second_stage_conf )
+{
+}
+
+void ERCoarseToFineDetection::setCoarseScale( double scale )
+{
+    NOCR_ASSERT( scale > 0 && scale <= 1, "coarse scale must be in range (0, 1]" );
+    scale_ = scale;
+}
+
+auto ERCoarseToFineDetection::getLetters( const cv::Mat &image )
+    -> vector<Storage>
+{
+    vector<cv::Rect> rois = getRegionsOfInterest( image );
+
+    int covered_area = 0;
+    for ( const cv::Rect &roi : rois )
+    {
+        covered_area += roi.area();
+    }
+
+    if ( covered_area > max_coverage_ * image.size().area() )
+    {
+        return detection_.getLetters( image );
+    }
+
+    vector<Storage> letters;
+    for ( const cv::Rect &roi : rois )
+    {
+        auto roi_letters = detection_.getLetters( image, roi );
+        letters.insert( letters.end(), roi_letters.begin(), roi_letters.end() );
+    }
+
+    return letters;
+}
+
+vector<cv::Rect> ERCoarseToFineDetection::getRegionsOfInterest( const cv::Mat &image )
+{
+    cv::Mat coarse_image;
+    cv::resize( image, coarse_image, cv::Size(), scale_, scale_, cv::INTER_AREA );
+
+    // relative bounds of region size are taken from the input image
+    double min_area_ratio, max_area_ratio;
+    std::tie(min_area_ratio, max_area_ratio) = ErLimitSize::getErSizeLimits( image.size() );
+    coarse_tree_.shareConfiguration( detection_.getTree() );
+    coarse_tree_.setMinAreaRatio( min_area_ratio );
+    coarse_tree_.setMaxAreaRatio( max_area_ratio );
+    coarse_workspace_.setImage( coarse_image );
+
+    vector<cv::Rect> rois;
+    auto collect = [this, &rois, &image] ( const ERRegion &region )
+    {
+        rois.push_back( toImageRect( region.getRectangle(), image.size() ) );
+    };
+
+    for ( int polarity = 0; polarity < 2; ++polarity )
+    {
+        if ( polarity == 1 )
+        {
+            coarse_tree_.invertDomain();
+        }
+
+        coarse_workspace_.buildTree();
+        coarse_tree_.transformExtreme();
+        coarse_tree_.processTree( collect );
+        coarse_tree_.deallocateTree();
+    }
+
+    mergeOverlappingRects( rois );
+    return rois;
+}
+
+cv::Rect ERCoarseToFineDetection::toImageRect( const cv::Rect &coarse_rect,
+        const cv::Size &image_size ) const
+{
+    // rectangle of region is in coordinates of bitmap with border
+    int left = std::floor( ( coarse_rect.x - 1 ) / scale_ );
+    int upper = std::floor( ( coarse_rect.y - 1 ) / scale_ );
+    int right = std::ceil( ( coarse_rect.x - 1 + coarse_rect.width ) / scale_ );
+    int lower = std::ceil( ( coarse_rect.y - 1 + coarse_rect.height ) / scale_ );
+
+    int margin = std::max<int>( min_margin_, margin_ratio_ * ( lower - upper ) );
+    cv::Rect rect( left - margin, upper - margin,
+            right - left + 2 * margin, lower - upper + 2 * margin );
+    return rect & cv::Rect( cv::Point( 0, 0 ), image_size );
+}
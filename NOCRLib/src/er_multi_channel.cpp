@@ -0,0 +1,112 @@
+/*
+ * Implementation of methods and classes declared in er_multi_channel.h
+ *
+ * Compiler: g++ 4.8.3
+ */
+#include "../include/nocrlib/er_multi_channel.h"
+#include "../include/nocrlib/assert.h"
+
+#include <opencv2/core/core.hpp>
+#include <opencv2/imgproc/imgproc.hpp>
+
+#include <future>
+
+using namespace std;
+
+ERMultiChannelDetection::ERMultiChannelDetection( const std::string &first_stage_conf,
+        const std::string &second_stage_conf,
+        const std::vector<ERChannel> &channels )
+    : detection_( first_stage_conf, second_stage_conf )
+{
+    setChannels( channels );
+}
+
+void ERMultiChannelDetection::setChannels( const std::vector<ERChannel> &channels )
+{
+    channels_ = channels;
+    channel_detections_.clear();
+    for ( std::size_t i = 0; i < channels_.size(); ++i )
+    {
+        channel_detections_.emplace_back( new ERTextDetection() );
+        // channels are already processed in parallel
+        channel_detections_.back()->getTree().setSecondStageThreadCount( 1 );
+    }
+}
+
+auto ERMultiChannelDetection::getChannelLetters( const cv::Mat &image )
+    -> vector< vector<Storage> >
+{
+    NOCR_ASSERT( image.type() == CV_8UC3, "wrong input image format" );
+
+    vector< future< vector<Storage> > > channel_futures;
+    channel_futures.reserve( channels_.size() );
+    for ( std::size_t i = 0; i < channels_.size(); ++i )
+    {
+        ERTextDetection * detection = channel_detections_[i].get();
+        detection->getTree().shareConfiguration( detection_.getTree() );
+
+        ERChannel channel = channels_[i];
+        channel_futures.push_back( std::async( std::launch::async,
+                    [detection, channel, &image] ()
+                    {
+                        return detection->getLetters( extractChannel( image, channel ) );
+                    }));
+    }
+
+    vector< vector<Storage> > channel_letters;
+    channel_letters.reserve( channels_.size() );
+    for ( auto &channel_future : channel_futures )
+    {
+        channel_letters.push_back( channel_future.get() );
+    }
+
+    return channel_letters;
+}
+
+cv::Mat ERMultiChannelDetection::extractChannel( const cv::Mat &image, ERChannel channel )
+{
+    cv::Mat output;
+    switch( channel )
+    {
+        case ERChannel::gray:
+            cv::cvtColor( image, output, CV_BGR2GRAY );
+            break;
+        case ERChannel::blue:
+            cv::extractChannel( image, output, 0 );
+            break;
+        case ERChannel::green:
+            cv::extractChannel( image, output, 1 );
+            break;
+        case ERChannel::red:
+            cv::extractChannel( image, output, 2 );
+            break;
+        case ERChannel::hue:
+        case ERChannel::saturation:
+        {
+            cv::Mat hsv;
+            cv::cvtColor( image, hsv, CV_BGR2HSV );
+            cv::extractChannel( hsv, output, channel == ERChannel::hue ? 0 : 1 );
+            break;
+        }
+        case ERChannel::gradient:
+        {
+            cv::Mat gray, dx, dy, magnitude;
+            cv::cvtColor( image, gray, CV_BGR2GRAY );
+            cv::Sobel( gray, dx, CV_32F, 1, 0 );
+            cv::Sobel( gray, dy, CV_32F, 0, 1 );
+            cv::magnitude( dx, dy, magnitude );
+            cv::normalize( magnitude, output, 0, 255, cv::NORM_MINMAX, CV_8UC1 );
+            break;
+        }
+    }
+
+    return output;
+}
+
+// ======== segmentation policy =====
+auto SegmentationPolicy<ERMultiChannelDetection>::merge
+    ( const vector< vector<MethodOutput> > &channel_letters )
+    -> vector<MethodOutput>
+{
+    return ErDuplicateFilter::filter( channel_letters );
+}
@@ -21,6 +21,44 @@ using namespace cv;
 
 const double ERRegion::EulerQuadRecordBit::k_c = 1/sqrt(2);
 const int ERRegion::PerimeterLengthTracker::quad_indices[] = { 1,3,4,6 };
+const std::uint32_t CrossingArena::k_none;
+const vector<ERRegion::EulerQuadRecordBit::Delta> 
+    ERRegion::EulerQuadRecordBit::k_neighbour_deltas = createNeighbourDeltas();
+
+std::uint16_t ERRegion::EulerQuadRecordBit::getQuadMask( std::uint8_t neighbours )
+{
+    auto bit = [neighbours] ( int i ) -> std::uint16_t
+    {
+        return ( neighbours >> i ) & 1;
+    };
+
+    std::uint16_t q1 = bit(0) | bit(1) << 1 | bit(3) << 2;
+    std::uint16_t q2 = bit(1) << 4 | bit(2) << 5 | bit(4) << 7;
+    std::uint16_t q3 = bit(3) << 8 | bit(5) << 10 | bit(6) << 11;
+    std::uint16_t q4 = bit(4) << 13 | bit(6) << 14 | bit(7) << 15;
+    return q1 | q2 | q3 | q4;
+}
+
+auto ERRegion::EulerQuadRecordBit::createNeighbourDeltas()
+    -> vector<Delta>
+{
+    // deltas are computed by update with quad masks, so both updates give 
+    // the same counts
+    vector<Delta> deltas( 256 );
+    for ( int neighbours = 0; neighbours < 256; ++neighbours )
+    {
+        EulerQuadRecordBit record;
+        record.update( getQuadMask( neighbours ) );
+
+        Delta &delta = deltas[neighbours];
+        delta.q1 = record.q1_count;
+        delta.q2 = record.q2_count;
+        delta.q2d = record.q2d_count;
+        delta.q3 = record.q3_count;
+    }
+
+    return deltas;
+}
 
 
 void ERRegion::EulerQuadRecordBit::update(std::uint16_t quads)
@@ -245,87 +283,100 @@ void ERRegion::EulerQuadRecordBit::update(std::uint16_t quads)
 
 
 void ERRegion::HorizontalCrossingTracker::
-        updateHorizontalCrossing( int y, int change )
+        updateHorizontalCrossing( int y, int change, CrossingArena &arena )
 {
     int actualChange = 2 - 2* change;
-    if ( y < y_min_ ) 
-    {
-        crossings_.push_front(2); 
-#if PRINT_INFO
-        if (y != y_min_ - 1)
-        {
-            cout << y << " " << y_min_ << endl;
-        }
-#endif
-        --y_min_;
-        return;
-    }
-
-    if ( y > y_max_ )
+    if ( y < y_min_ || y > y_max_ ) 
     {
-        crossings_.push_back(2);
 #if PRINT_INFO
-        if (y != y_max_ + 1)
+        if (y != y_min_ - 1 && y != y_max_ + 1)
         {
-            cout << y << " " << y_max_ << endl;
+            cout << y << " " << y_min_ << " " << y_max_ << endl;
         }
 #endif
-        ++y_max_;
+        extend( y, y, arena );
+        getData( arena )[ first_ + y - y_min_ ] = 2;
         return;
     }
 
-    crossings_[y - y_min_ ] += actualChange;
+    getData( arena )[ first_ + y - y_min_ ] += actualChange;
 }
 
 
 /**
- * @brief 
+ * @brief adds crossings of other tracker, rows missing in both
+ * trackers have zero crossings
  *
  * @param other
  */
 void ERRegion::HorizontalCrossingTracker::
-            merge( const HorizontalCrossingTracker &other )
+            merge( const HorizontalCrossingTracker &other, CrossingArena &arena )
 {
-    for ( int i = std::max( y_min_, other.y_min_ ); i <= std::min( y_max_, other.y_max_); ++i )
+    extend( other.y_min_, other.y_max_, arena );
+
+    int * data = getData( arena ) + first_ - y_min_;
+    const int * other_data = other.getData( arena ) + other.first_ - other.y_min_;
+    for ( int i = other.y_min_; i <= other.y_max_; ++i )
     {
-        crossings_[  i-y_min_ ] += other.crossings_[ i-other.y_min_ ];
+        data[i] += other_data[i];
     }
-    // add crossings not included in parent 
-    int pom = y_min_ - 1;
-    if ( y_min_ > other.y_max_ ) 
+}
+
+
+/**
+ * @brief extends row range to contain [y_min, y_max], 
+ * new rows have zero crossings
+ *
+ * If the range doesn't fit into storage, crossings are moved 
+ * to new block with the range in the middle of it.
+ */
+void ERRegion::HorizontalCrossingTracker::
+            extend( int y_min, int y_max, CrossingArena &arena )
+{
+    int new_min = std::min( y_min, y_min_ );
+    int new_max = std::max( y_max, y_max_ );
+    if ( new_min == y_min_ && new_max == y_max_ )
     {
-        while( (unsigned)( pom- other.y_min_ ) >= other.crossings_.size() )
-        {
-            crossings_.push_front(0);
-            --pom;
-        }
+        return;
     }
 
-    for ( int i = pom; i >= other.y_min_; --i )
+    int height = y_max_ - y_min_ + 1;
+    int new_height = new_max - new_min + 1;
+    int new_first = first_ - ( y_min_ - new_min );
+    if ( new_first >= 0 && new_first + new_height <= getCapacity() )
     {
-        int tmp = other.crossings_[  i - other.y_min_ ];
-        crossings_.push_front( tmp ); 
+        int * data = getData( arena );
+        std::fill( data + new_first, data + first_, 0 );
+        std::fill( data + first_ + height, data + new_first + new_height, 0 );
+        first_ = new_first;
     }
-
-    // add crossing after y_max_
-    pom = y_max_ + 1;
-    if ( y_max_ < other.y_min_ )
+    else
     {
-        while( ( pom - other.y_min_ ) < 0 )
+        int size_class = 0;
+        while ( ( 1 << size_class ) < 2 * new_height )
         {
-            crossings_.push_back(0);
-            ++pom;
+            ++size_class;
         }
-    }
 
-    for ( int i = pom; i <= other.y_max_; ++i )
-    {
-        int tmp = other.crossings_[ i - other.y_min_ ];
-        crossings_.push_back( tmp );
+        // allocation can move arena storage, old crossings are read after it
+        std::uint32_t offset = arena.allocate( size_class );
+        new_first = ( ( 1 << size_class ) - new_height ) / 2;
+        int * data = arena.getBlock( offset ) + new_first;
+        const int * old_data = getData( arena ) + first_;
+
+        int before = y_min_ - new_min;
+        std::fill( data, data + before, 0 );
+        std::copy( old_data, old_data + height, data + before );
+        std::fill( data + before + height, data + new_height, 0 );
+
+        release( arena );
+        size_class_ = size_class;
+        offset_ = offset;
+        first_ = new_first;
     }
 
-    y_max_ = std::max( y_max_, other.y_max_ );
-    y_min_ = std::min( y_min_, other.y_min_ );
+    y_min_ = new_min;
+    y_max_ = new_max;
 }
 
 
@@ -334,12 +385,13 @@ void ERRegion::HorizontalCrossingTracker::
  *
  * @return 
  */
-int ERRegion::HorizontalCrossingTracker::getMedian() const
+int ERRegion::HorizontalCrossingTracker::getMedian( const CrossingArena &arena ) const
 {
+    const int * crossings = getData( arena ) + first_;
     int height = y_max_ - y_min_ + 1;
-    int a = crossings_[height/6];
-    int b = crossings_[height/2];
-    int c = crossings_[height*5/6];
+    int a = crossings[height/6];
+    int b = crossings[height/2];
+    int c = crossings[height*5/6];
     if ( (a-b)*(c-a) >= 0 )
         return a;
     else if ( (b-a)*(c-b) >= 0 )
@@ -350,16 +402,23 @@ int ERRegion::HorizontalCrossingTracker::getMedian() const
 
 void ERRegion::HorizontalCrossingTracker::swap( HorizontalCrossingTracker &other )
 {
-    std::swap( y_min_, other.y_min_ );
-    std::swap( y_max_, other.y_max_ );
-    crossings_.swap( other.crossings_ );
+    std::swap( *this, other );
+}
+
+void ERRegion::HorizontalCrossingTracker::release( CrossingArena &arena )
+{
+    if ( size_class_ >= 0 )
+    {
+        arena.release( offset_, size_class_ );
+        size_class_ = -1;
+    }
 }
 
 ERRegion::ERRegion( int grayLevel ) :
     // parent_(nullptr), child_(nullptr), next_(nullptr), 
     // prev_(nullptr), depth_from_parent_(0), last_child_(nullptr),
     grayLevel_( grayLevel ), size_(0), 
-    head_(nullptr), tail_(nullptr)
+    head_(0), tail_(0), links_(nullptr)
 {
     init();
 } 
@@ -369,7 +428,7 @@ ERRegion::ERRegion( int grayLevel, cv::Point p ) :
     // parent_(nullptr), child_(nullptr), next_(nullptr), 
     // prev_(nullptr), depth_from_parent_(0), last_child_( nullptr ),
     grayLevel_( grayLevel ), size_(0), 
-    head_(nullptr), tail_(nullptr)
+    head_(0), tail_(0), links_(nullptr)
 {
     x_max_ = p.x;
     x_min_ = p.x;
@@ -384,45 +443,25 @@ ERRegion::ERRegion( int grayLevel, cv::Point p ) :
 } 
 
 
-ERRegion::~ERRegion() 
-{
-    /*
-     * parent_ = nullptr;
-     * child_ = nullptr;
-     * next_ = nullptr;
-     * prev_ = nullptr;
-     * last_child_ = nullptr;
-     */
-    head_ = nullptr;
-    tail_ = nullptr;
-}
-
-
-
-// void ERRegion::addPoint( LinkedPoint *point, int horizontalCrossingChange, bool *quad )
-void ERRegion::addPoint( LinkedPoint *point, int horizontalCrossingChange)
+void ERRegion::addPoint( std::uint32_t code, cv::Point point, int horizontalCrossingChange, 
+        PixelLinks &links, CrossingArena &arena )
 {
     if ( size_ > 0 ) 
     {
-        point->prev_ = tail_;
-        tail_->next_ = point;
-        point->next_ = nullptr; 
+        links.link( tail_, code );
     }
     else 
     {
-        point->prev_ = nullptr;
-        point->next_ = nullptr;
-        head_ = point;
+        head_ = code;
+        links_ = &links;
     }
-    // std::cout << point->val_ << std::endl;
-
     
-    tail_ = point;
+    tail_ = code;
     ++size_;
     // rec_.update( quad ); 
-    horizontal_crossings_.updateHorizontalCrossing( point->val_.y, horizontalCrossingChange );
+    horizontal_crossings_.updateHorizontalCrossing( point.y, horizontalCrossingChange, arena );
     // perim_.updateChange( quad );
-    updateSize( point->val_ );
+    updateSize( point );
 }
 
 void ERRegion::setProbability( float probability )
@@ -459,13 +498,11 @@ void ERRegion::updateEulerBit(std::uint16_t quads)
     bit_rec_.update(quads);
 }
 
-void ERRegion::merge( ERRegion &child )
+void ERRegion::merge( ERRegion &child, CrossingArena &arena )
 {
     if ( child.size_ > 0 && size_ > 0 )
     {
-        tail_->next_ = child.head_;
-        child.head_->prev_ = tail_;
-
+        links_->link( tail_, child.head_ );
         tail_ = child.tail_;
     }
 
@@ -473,18 +510,20 @@ void ERRegion::merge( ERRegion &child )
     {
         head_ = child.head_;
         tail_ = child.tail_;
+        links_ = child.links_;
     }
 
     // horizontal_crossings_.merge( child.horizontal_crossings_ );
     if ( horizontal_crossings_.getSize() >= child.horizontal_crossings_.getSize() )
     {
-        horizontal_crossings_.merge( child.horizontal_crossings_ );
+        horizontal_crossings_.merge( child.horizontal_crossings_, arena );
     }
     else
     {
-        child.horizontal_crossings_.merge( horizontal_crossings_ );
+        child.horizontal_crossings_.merge( horizontal_crossings_, arena );
         horizontal_crossings_.swap( child.horizontal_crossings_ );
     }
+    child.horizontal_crossings_.release( arena );
 
     // update size
     x_max_ = std::max( x_max_, child.x_max_ );
@@ -499,18 +538,24 @@ void ERRegion::merge( ERRegion &child )
     // perim_.merge( child.perim_ );
 }
 
-void ERRegion::setMedianCrossing() 
+void ERRegion::setMedianCrossing( const CrossingArena &arena ) 
 {
-    med_crossing = horizontal_crossings_.getMedian();
+    med_crossing = horizontal_crossings_.getMedian( arena );
 }
 
 vector<float> ERRegion::getFeatures() const
 {
-    float aspect_ratio = (float) getWidth()/getHeight();
-    float compactness = (float) (std::sqrt( size_ ))/bit_rec_.getPerimeterLength();
+    vector<float> features( 4 );
+    getFeatures( features.data() );
+    return features;
+}
 
-    return { aspect_ratio, compactness, 
-        (float)1 - bit_rec_.getEulerNumber(), (float)med_crossing };
+void ERRegion::getFeatures( float *features ) const
+{
+    features[0] = (float) getWidth()/getHeight();
+    features[1] = (float) (std::sqrt( size_ ))/bit_rec_.getPerimeterLength();
+    features[2] = (float)1 - bit_rec_.getEulerNumber();
+    features[3] = (float)med_crossing;
 }
 
 Component ERRegion::toComponent() const
@@ -519,9 +564,10 @@ Component ERRegion::toComponent() const
     out.reserve( size_ );
     cv::Point offset( 1, 1);
     
-    for ( LinkedPoint* p = head_; p != tail_->next_ ; p = p->next_ ) 
+    std::uint32_t code = head_;
+    for ( size_t i = 0; i < size_; ++i, code = links_->getNext( code ) ) 
     {
-        out.addPointWithoutUpdatingSize( p->val_  - offset ); 
+        out.addPointWithoutUpdatingSize( links_->decode( code ) - offset ); 
     }
 
     out.setLeft( x_min_ - 1 );
@@ -532,6 +578,18 @@ Component ERRegion::toComponent() const
     return out;
 }
 
+void ERRegion::getPoints( vector<cv::Point> &points ) const
+{
+    points.resize( size_ );
+    cv::Point offset( 1, 1 );
+
+    std::uint32_t code = head_;
+    for ( size_t i = 0; i < size_; ++i, code = links_->getNext( code ) ) 
+    {
+        points[i] = links_->decode( code ) - offset; 
+    }
+}
+
 auto ERRegion::toCompPtr() 
     -> CompPtr
 {
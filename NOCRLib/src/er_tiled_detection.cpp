@@ -0,0 +1,277 @@
+/*
+ * Implementation of methods and classes declared in er_tiled_detection.h
+ *
+ * Compiler: g++ 4.8.3
+ */
+#include "../include/nocrlib/er_tiled_detection.h"
+#include "../include/nocrlib/assert.h"
+
+#include <opencv2/core/core.hpp>
+
+#include <future>
+#include <thread>
+#include <atomic>
+#include <algorithm>
+#include <limits>
+
+using namespace std;
+
+const double ERTiledDetection::k_min_seam_similarity = 0.9;
+
+ERTiledDetection::ERTiledDetection( const std::string &first_stage_conf,
+        const std::string &second_stage_conf )
+    : detection_( first_stage_conf, second_stage_conf )
+{
+    setThreadCount( std::max( std::thread::hardware_concurrency(), 1u ) );
+}
+
+void ERTiledDetection::setThreadCount( unsigned thread_count )
+{
+    NOCR_ASSERT( thread_count > 0, "thread count must be greater than 0" );
+
+    workers_.clear();
+    for ( unsigned i = 0; i < thread_count; ++i )
+    {
+        workers_.emplace_back( new ERTextDetection() );
+        // strips are already processed in parallel
+        workers_.back()->getTree().setSecondStageThreadCount( 1 );
+    }
+}
+
+auto ERTiledDetection::getLetters( const cv::Mat &image )
+    -> vector<Storage>
+{
+    if ( image.size().area() <= min_tiled_area_ || image.rows <= strip_height_ + overlap_ )
+    {
+        return detection_.getLetters( image );
+    }
+
+    vector<cv::Range> strips = getStrips( image.rows );
+    return mergeStrips( processStrips( image, strips ), strips );
+}
+
+vector<cv::Range> ERTiledDetection::getStrips( int rows ) const
+{
+    vector<cv::Range> strips;
+    for ( int start = 0; ; start += strip_height_ )
+    {
+        int end = std::min( rows, start + strip_height_ + overlap_ );
+        strips.emplace_back( start, end );
+        if ( end == rows )
+        {
+            break;
+        }
+    }
+
+    return strips;
+}
+
+auto ERTiledDetection::processStrips( const cv::Mat &image,
+        const vector<cv::Range> &strips )
+    -> vector< vector<Storage> >
+{
+    vector< vector<Storage> > strip_letters( strips.size() );
+    std::atomic<std::size_t> next_strip( 0 );
+
+    std::size_t worker_count = std::min( workers_.size(), strips.size() );
+    vector< future<void> > worker_futures;
+    worker_futures.reserve( worker_count );
+    for ( std::size_t w = 0; w < worker_count; ++w )
+    {
+        ERTextDetection * worker = workers_[w].get();
+        worker->getTree().shareConfiguration( detection_.getTree() );
+
+        worker_futures.push_back( std::async( std::launch::async,
+                    [worker, &image, &strips, &strip_letters, &next_strip] ()
+                    {
+                        for ( std::size_t i = next_strip++; i < strips.size(); i = next_strip++ )
+                        {
+                            cv::Rect strip( 0, strips[i].start, image.cols, strips[i].size() );
+                            strip_letters[i] = worker->getLetters( image, strip );
+                        }
+                    }));
+    }
+
+    for ( auto &worker_future : worker_futures )
+    {
+        worker_future.get();
+    }
+
+    return strip_letters;
+}
+
+auto ERTiledDetection::mergeStrips( const vector< vector<Storage> > &strip_letters,
+        const vector<cv::Range> &strips ) const
+    -> vector<Storage>
+{
+    vector<Storage> output;
+    // letters cut by the lower seam of previous strip
+    vector<Storage> open_letters;
+
+    for ( std::size_t i = 0; i < strips.size(); ++i )
+    {
+        bool first = i == 0;
+        bool last = i + 1 == strips.size();
+        const cv::Range &strip = strips[i];
+
+        vector<Storage> next_open_letters;
+        vector<bool> joined( open_letters.size(), false );
+        for ( const Storage &strip_letter : strip_letters[i] )
+        {
+            Storage letter = strip_letter;
+            bool cut_upper = !first && letter.getUpper() == strip.start;
+            bool cut_lower = !last && letter.getLower() == strip.end - 1;
+
+            if ( cut_upper )
+            {
+                cv::Range seam( strip.start, strips[i - 1].end );
+                int partner = findSeamPartner( open_letters, letter, seam );
+                if ( partner >= 0 )
+                {
+                    letter = join( open_letters[partner], letter, seam.end );
+                    joined[partner] = true;
+                }
+                else if ( letter.getLower() < seam.end - 1 )
+                {
+                    // letter lies in the overlap, previous strip has it whole
+                    continue;
+                }
+                // otherwise letter starts on the seam or its upper part was
+                // rejected in previous strip, it is kept as it is
+            }
+
+            if ( cut_lower )
+            {
+                next_open_letters.push_back( letter );
+            }
+            else
+            {
+                output.push_back( letter );
+            }
+        }
+
+        // upper parts, whose lower part was rejected, are kept, open letters 
+        // starting in the overlap are whole in this strip
+        for ( std::size_t j = 0; j < open_letters.size(); ++j )
+        {
+            if ( !joined[j] && open_letters[j].getUpper() < strip.start )
+            {
+                output.push_back( open_letters[j] );
+            }
+        }
+
+        open_letters.swap( next_open_letters );
+    }
+
+    // letters found in overlap of two strips are present twice
+    return ErDuplicateFilter::filter( { output } );
+}
+
+int ERTiledDetection::findSeamPartner( const vector<Storage> &open_letters,
+        const Storage &letter, const cv::Range &seam ) const
+{
+    vector<cv::Point> seam_points = getSeamPoints( letter, seam );
+    auto less_point = [] ( const cv::Point &a, const cv::Point &b )
+    {
+        return a.y < b.y || ( a.y == b.y && a.x < b.x );
+    };
+
+    int best_partner = -1;
+    double best_similarity = k_min_seam_similarity;
+    for ( std::size_t i = 0; i < open_letters.size(); ++i )
+    {
+        const Storage &open_letter = open_letters[i];
+        if ( open_letter.getRight() < letter.getLeft()
+                || open_letter.getLeft() > letter.getRight() )
+        {
+            continue;
+        }
+
+        vector<cv::Point> open_seam_points = getSeamPoints( open_letter, seam );
+
+        std::size_t intersection = 0;
+        auto it_a = seam_points.begin();
+        auto it_b = open_seam_points.begin();
+        while ( it_a != seam_points.end() && it_b != open_seam_points.end() )
+        {
+            if ( less_point( *it_a, *it_b ) )
+            {
+                ++it_a;
+            }
+            else if ( less_point( *it_b, *it_a ) )
+            {
+                ++it_b;
+            }
+            else
+            {
+                ++intersection;
+                ++it_a;
+                ++it_b;
+            }
+        }
+
+        std::size_t union_size = seam_points.size() + open_seam_points.size() - intersection;
+        double similarity = union_size ? (double) intersection / union_size : 0;
+        if ( similarity >= best_similarity )
+        {
+            best_similarity = similarity;
+            best_partner = i;
+        }
+    }
+
+    return best_partner;
+}
+
+auto ERTiledDetection::join( const Storage &upper, const Storage &lower, int seam_end )
+    -> Storage
+{
+    Storage output;
+    output.reserve( upper.size() + lower.size() );
+
+    int left = upper.getLeft(), right = upper.getRight();
+    int lower_border = upper.getLower();
+    for ( const cv::Point &p : upper.getPoints() )
+    {
+        output.addPointWithoutUpdatingSize( p );
+    }
+
+    // rows above seam end are already covered by upper part
+    for ( const cv::Point &p : lower.getPoints() )
+    {
+        if ( p.y >= seam_end )
+        {
+            output.addPointWithoutUpdatingSize( p );
+            left = std::min( left, p.x );
+            right = std::max( right, p.x );
+            lower_border = std::max( lower_border, p.y );
+        }
+    }
+
+    output.setLeft( left );
+    output.setRight( right );
+    output.setUpper( upper.getUpper() );
+    output.setLower( lower_border );
+
+    return output;
+}
+
+vector<cv::Point> ERTiledDetection::getSeamPoints( const Storage &letter,
+        const cv::Range &seam )
+{
+    vector<cv::Point> seam_points;
+    for ( const cv::Point &p : letter.getPoints() )
+    {
+        if ( p.y >= seam.start && p.y < seam.end )
+        {
+            seam_points.push_back( p );
+        }
+    }
+
+    std::sort( seam_points.begin(), seam_points.end(),
+            [] ( const cv::Point &a, const cv::Point &b )
+            {
+                return a.y < b.y || ( a.y == b.y && a.x < b.x );
+            });
+
+    return seam_points;
+}
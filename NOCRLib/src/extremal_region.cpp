@@ -6,59 +6,120 @@
  */
 #include "../include/nocrlib/extremal_region.h"
 #include "../include/nocrlib/assert.h"
+#include "../include/nocrlib/region_runs.h"
+#include "../include/nocrlib/features.h"
 #include <opencv2/core/core.hpp>
 
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include <future>
+#include <thread>
+#include <atomic>
+#include <tuple>
+#include <algorithm>
+
 using namespace std;
 
 float ERFilter1Stage::getProbability( const ERRegion &r )
+{
+    float sum = flat_boost_.empty() ? getOpenCVSum( r ) : getFlatSum( r ); 
+    return 1/(1 + std::exp( -2 * sum ) );
+}
+
+float ERFilter1Stage::getOpenCVSum( const ERRegion &r ) const
 {
     vector<float> data = r.getFeatures();
     cv::Mat features_mat( data );
-    float sum = boost_.predict( features_mat ); 
-    return 1/(1 + std::exp( -2 * sum ) );
+    return boost_.predict( features_mat ); 
+}
+
+float ERFilter1Stage::getFlatSum( const ERRegion &r ) const
+{
+    float features[ FeatureTraits<feature::ERGeom>::features_length ];
+    r.getFeatures( features );
+    return flat_boost_.predict( features );
 }
 
 
 bool ERFilter2Stage::isLetter( ERRegion &r )
+{
+    return svm_.predict( getFeatures( r ) ) == 1;
+}
+
+vector<float> ERFilter2Stage::getFeatures( const ERRegion &r ) const
+{
+    vector<cv::Point> points;
+    r.getPoints( points );
+
+    RegionRuns runs;
+    runs.build( points );
+
+    vector<cv::Point> contour;
+    runs.getOuterContour( contour );
+    double epsilon = (double) std::min( runs.getRows(), runs.getCols() ) / 17;
+
+    vector<float> features = r.getFeatures();
+    features.push_back( (float) runs.getHoleArea() / points.size() );
+    features.push_back( (float) points.size() / runs.getConvexHullArea() );
+    features.push_back( InflectionPoints::computeNumberOfInflections( contour, epsilon ) );
+    return features;
+}
+
+vector<float> ERFilter2Stage::getRasterFeatures( const ERRegion &r )
 {
     auto c = r.toComponent();
     vector<float> features = r.getFeatures();
     vector<float> data = features_extractor_->compute(c);
     features.insert( features.end(), data.begin(), data.end() );
-    /*
-     * for( float f : features )
-     * {
-     *     cout << f << ':';
-     * }
-     * cout << endl;
-     */
-    
-    return svm_.predict( features ) == 1;
+    return features;
 }
 
 // ==================================extremal region============================
 
+const std::int16_t ERTree::k_not_accumulated;
+
 ERTree::ERTree( double min_area_ratio, double max_area_ratio ) 
-    : root_(nullptr), min_area_ratio_(min_area_ratio),max_area_ratio_(max_area_ratio)
+    : root_(TreeType::k_none), second_stage_threads_(getDefaultThreadCount()),
+    filter2_(std::make_shared<ERFilter2Stage>()),
+    min_area_ratio_(min_area_ratio),max_area_ratio_(max_area_ratio)
     
 {
 }
 
 void ERTree::loadSecondStageConf( const string &second_stage_conf )
 {
-    filter2_.loadConfiguration( second_stage_conf );
+    filter2_->loadConfiguration( second_stage_conf );
+}
+
+void ERTree::shareConfiguration( const ERTree &other )
+{
+    er_function_ = other.er_function_;
+    filter2_ = other.filter2_;
+
+    min_global_prob_ = other.min_global_prob_;
+    candidate_budget_ = other.candidate_budget_;
+    min_delta_ = other.min_delta_;
+    delta_ = other.delta_;
 }
 
 void ERTree::setImage( const cv::Mat &image )
 {
+    // buffers are reused, if they are large enough
+    const uchar *bitmap_data = bitmap_.data;
+    std::size_t accumulated_capacity = accumulated_keys_.capacity();
+    std::size_t links_capacity = pixel_links_.getCapacity();
+
     if ( image.type() == CV_8UC3 )
     {
         // image has BGR format
         // cv::split( image, bgr_mat );
-        cv::Mat gray_image;
-        cv::cvtColor( image, gray_image, CV_BGR2GRAY ); 
+        const uchar *gray_data = gray_image_.data;
+        cv::cvtColor( image, gray_image_, CV_BGR2GRAY ); 
+        allocations_ += gray_image_.data != gray_data;
         // bgr_mat.push_back( gray_image );
-        cv::copyMakeBorder( gray_image, bitmap_, 1, 1, 1, 1, cv::BORDER_CONSTANT, 255 );
+        cv::copyMakeBorder( gray_image_, bitmap_, 1, 1, 1, 1, cv::BORDER_CONSTANT, 255 );
     }
     else if ( image.type() == CV_8UC1 )
     {
@@ -78,295 +139,352 @@ void ERTree::setImage( const cv::Mat &image )
     cols_ = image.cols + 2;
 
     // zero padding
-    processed_points_ = 0;
     int image_size = image.rows * image.cols;
     min_area_ = std::max( min_area_limit, (int)(min_area_ratio_ * image_size) );
 
     max_area_ = max_area_ratio_ * image_size;
 
-    accumulated_pixels_ = std::vector<bool>( rows_ * cols_, false ); 
-    points_.resize( image_size );
+    accumulated_keys_.assign( rows_ * cols_ + k_keys_padding, k_not_accumulated ); 
+    pixel_links_.reset( rows_, cols_ );
+    crossing_arena_.clear();
+
+    allocations_ += ( bitmap_.data != bitmap_data )
+        + ( accumulated_keys_.capacity() > accumulated_capacity )
+        + ( pixel_links_.getCapacity() > links_capacity );
+
     er_function_->setImage( image );
 }
 
 void ERTree::invertDomain()
 {
-    processed_points_ = 0;
     cv::Rect domain_rect(1, 1, cols_ - 2, rows_ - 2 );
     cv::Mat domain = bitmap_( domain_rect );
     cv::bitwise_not( domain, domain );
-    std::replace( accumulated_pixels_.begin(), accumulated_pixels_.end(),
-            true, false );
-}
-
-void ERTree::accumulate( NodeType *reg, int code )
-{
-    const uchar* image_data = bitmap_.data;
-    cv::Point accumulated_point = getPoint( code );
-    points_[processed_points_].val_ = accumulated_point; 
-
-    int horiz_cross_change = 0;
-    uchar pVal = image_data[code];
-    std::uint16_t mask = 0;
-    // case 0: 
-        int ncode0 = code - 1 - cols_; 
-        bool acc_neighbour0 = ((accumulated_pixels_[ncode0])
-                && (image_data[ncode0] <= pVal));
-    // case 1: 
-        int ncode1 = code - cols_; 
-        bool acc_neighbour1 = ((accumulated_pixels_[ncode1])
-                && (image_data[ncode1] <= pVal));
-
-    // case 2: 
-        int ncode2 = code + 1 - cols_; 
-        bool acc_neighbour2 = ((accumulated_pixels_[ncode2])
-                && (image_data[ncode2] <= pVal));
-         
-    // case 3: 
-        int ncode3 = code - 1; 
-        bool acc_neighbour3 = ((accumulated_pixels_[ncode3])
-                && (image_data[ncode3] <= pVal));
-
-        if (acc_neighbour3)
-            horiz_cross_change++;
-
-    // case 4: 
-        int ncode4 = code + 1; 
-        bool acc_neighbour4 = ((accumulated_pixels_[ncode4])
-                && (image_data[ncode4] <= pVal));
-
-        if (acc_neighbour4)
-            horiz_cross_change++;
-
-    // case 5: 
-        int ncode5 = code - 1 + cols_; 
-        bool acc_neighbour5 = ((accumulated_pixels_[ncode5])
-                && (image_data[ncode5] <= pVal));
-    // case 6: 
-        int ncode6 = code + cols_; 
-        bool acc_neighbour6 = ((accumulated_pixels_[ncode6])
-                && (image_data[ncode6] <= pVal));
-
-    // case 7: 
-        int ncode7 = code + 1 + cols_; 
-        bool acc_neighbour7 = ((accumulated_pixels_[ncode7])
-                && (image_data[ncode7] <= pVal));
-
-        std::uint16_t q1 = acc_neighbour0 | acc_neighbour1 << 1 | acc_neighbour3 << 2;
-        std::uint16_t q2 = acc_neighbour1 << 4| acc_neighbour2 << 5 | acc_neighbour4 << 7;
-        std::uint16_t q3 = acc_neighbour3 << 8 | acc_neighbour5 << 10 | acc_neighbour6 << 11;
-        std::uint16_t q4 = acc_neighbour4 << 13| acc_neighbour6 << 14 | acc_neighbour7 << 15;
-
-        mask = q1 | q2 | q3 | q4;
-
+    std::fill( accumulated_keys_.begin(), accumulated_keys_.end(), k_not_accumulated );
+}
 
-    ERRegion * ptr = &reg->getVal();
+void ERTree::accumulate( NodeId reg, int code )
+{
+    std::uint8_t neighbours = getAccumulatedNeighbours( code );
+    // left and right neighbour
+    int horiz_cross_change = ( ( neighbours >> 3 ) & 1 ) + ( ( neighbours >> 4 ) & 1 );
+
+    ERRegion &region = tree_.getVal(reg);
+    region.addPoint( code, getPoint( code ), horiz_cross_change, pixel_links_, crossing_arena_ );
+    region.updateEuler( neighbours );
+    accumulated_keys_[code] = bitmap_.data[code];
+}
 
-    // ptr->addPoint( &points_[processed_points_++], 
-    //                         horiz_cross_change , quad );
-    ptr->addPoint( &points_[processed_points_++], horiz_cross_change);
-    // minus offset (1,1) because of add zero border
-    // ptr->updateMeans( 
-    //         value_mat_.at<cv::Vec4b>( accumulated_point.y - 1, accumulated_point.x -1 ) );
-    ptr->updateEulerBit(mask);
-    accumulated_pixels_[code] = true;
+std::uint8_t ERTree::getAccumulatedNeighbours( int code ) const
+{
+    // keys of upper left neighbour and 3 following pixels
+    const std::int16_t *upper = accumulated_keys_.data() + code - cols_ - 1;
+    const std::int16_t *middle = upper + cols_;
+    const std::int16_t *lower = middle + cols_;
+    std::int16_t level = bitmap_.data[code];
+
+#if defined(__SSE2__)
+    __m128i levels = _mm_set1_epi16( level );
+    __m128i upper_middle = _mm_unpacklo_epi64( 
+            _mm_loadl_epi64( reinterpret_cast<const __m128i *>( upper ) ),
+            _mm_loadl_epi64( reinterpret_cast<const __m128i *>( middle ) ) );
+    __m128i lower_keys = _mm_loadl_epi64( reinterpret_cast<const __m128i *>( lower ) );
+
+    // two bits per key, bits of key i start at 2 * i
+    unsigned a = ~(unsigned) _mm_movemask_epi8( _mm_cmpgt_epi16( upper_middle, levels ) );
+    unsigned b = ~(unsigned) _mm_movemask_epi8( _mm_cmpgt_epi16( lower_keys, levels ) );
+
+    return ( a & 1 ) | ( ( a >> 1 ) & 2 ) | ( ( a >> 2 ) & 4 ) 
+        | ( ( a >> 5 ) & 8 ) | ( ( a >> 8 ) & 16 )
+        | ( ( b << 5 ) & 32 ) | ( ( b << 4 ) & 64 ) | ( ( b << 3 ) & 128 );
+#else
+    return ( upper[0] <= level ) | ( upper[1] <= level ) << 1 | ( upper[2] <= level ) << 2 
+        | ( middle[0] <= level ) << 3 | ( middle[2] <= level ) << 4
+        | ( lower[0] <= level ) << 5 | ( lower[1] <= level ) << 6 | ( lower[2] <= level ) << 7;
+#endif
 }
 
-void ERTree::merge( NodeType *child, NodeType *parent )
+void ERTree::merge( NodeId child, NodeId parent )
 {
-    child->getVal().setMedianCrossing();
+    ERRegion &child_region = tree_.getVal(child);
+    child_region.setMedianCrossing( crossing_arena_ );
     // connect children to its parent
-    parent->getVal().merge( child->getVal() );
+    tree_.getVal(parent).merge( child_region, crossing_arena_ );
     // check geometric requirement for region for probability evaluation
-    int size = child->getVal().getSize();
+    int size = child_region.getSize();
     if ( size > min_area_ && size < max_area_
-            && child->getVal().getHeight() > 2 && child->getVal().getWidth() > 2 )
+            && child_region.getHeight() > 2 && child_region.getWidth() > 2 )
     {
 
         // check probability requirement
-        float prob = er_function_->getProbability( child->getVal() ); 
-        child->getVal().setProbability( prob );
+        float prob = er_function_->getProbability( child_region ); 
+        child_region.setProbability( prob );
         if ( prob > min_global_prob_ )
         {
             // child node meets conditions to be an ER
-            parent->addChild( child );
-            // update parent child probabilities
-            // setChildrensProbabilities( parent,child );
+            tree_.addChild( parent, child );
             return;
         }
     }
 
     // else we deallocate children and connect childs children to parent
-    // and update parent child probabilities
-    parent->reconnectChildren( child );
-    // ProbabilityRecord child_max = child->getVal().getChildMaxProbability();
-    // ProbabilityRecord parent_max = parent->getVal().getChildMaxProbability();
-    // if ( child_max > parent_max )
-    // {
-    //     parent->getVal().setChildMaxProbability( child_max );
-    // }
-    //
-    // ProbabilityRecord child_min = child->getVal().getChildMinProbability();
-    // ProbabilityRecord parent_min = parent->getVal().getChildMinProbability();
-    // if ( child_min < parent_min )
-    // {
-    //     parent->getVal().setChildMinProbability( child_min );
-    // }
+    tree_.reconnectChildren( parent, child );
 
     // child node isn't needed anymore 
-    // delete child;
-    memory_pool_allocator_.destroy(child);
-    memory_pool_allocator_.deallocate(child);
-    // memory_pool_.destroy(child);
+    tree_.destroyNode( child );
+}
+
+void ERTree::join( NodeId node, NodeId target )
+{
+    tree_.getVal(target).merge( tree_.getVal(node), crossing_arena_ );
+    tree_.reconnectChildren( target, node );
+    destroyNode( node );
 }
 
 auto ERTree::createNode(cv::Point p, int level)
-    -> NodeType *
+    -> NodeId
 {
-    ERRegion r( level, p );
-    NodeType * chunk = memory_pool_allocator_.allocate();
-    NodeType tmp(level, p);
-    memory_pool_allocator_.construct(chunk, tmp);
-    return chunk;
+    return tree_.createNode(level, p);
 }
 
 auto ERTree::createRootNode()
-    -> NodeType *
+    -> NodeId
 {
-    NodeType * chunk = memory_pool_allocator_.allocate();
-    NodeType tmp(256);
-    memory_pool_allocator_.construct(chunk, tmp);
-    return chunk;
+    return tree_.createNode(256);
 }
 
-void ERTree::destroyNode(NodeType * node)
+void ERTree::destroyNode(NodeId node)
 {
-    // memory_pool_.destroy(node);
-    memory_pool_allocator_.destroy(node);
-    memory_pool_allocator_.deallocate(node);
+    tree_.destroyNode(node);
 }
 
 
 vector< Component > ERTree::getLetters( bool deallocate )
 {
-    transformExtreme(); 
-    
+    // extreme regions and second stage decisions are made on the unchanged 
+    // tree, the same way as in transformExtreme and transform2StageFiltering
+    candidate_nodes_.clear();
+    for ( NodeId node = 0; node < tree_.getSize(); ++node )
+    {
+        if ( node != root_ && tree_.isAlive(node) && isExtremeRegion(node) )
+        {
+            candidate_nodes_.push_back( node );
+        }
+    }
+
 #ifdef PRINT_INFO
-    std::cout << "first stage " << root_->getNodeCount() << endl;
+    std::cout << "first stage " << candidate_nodes_.size() + 1 << endl;
 #endif
-     
-    transform2StageFiltering();
 
+    applyCandidateBudget();
+    classifyCandidates();
 
-#ifdef PRINT_INFO
-    std::cout << "second stage " << root_->getNodeCount() << endl;
-#endif
+    kept_nodes_.assign( tree_.getSize(), 0 );
+    for ( std::size_t i = 0; i < candidate_nodes_.size(); ++i )
+    {
+        kept_nodes_[ candidate_nodes_[i] ] = letter_decisions_[i];
+    }
 
-    /*
-     * transform([] (NodeType * node) -> bool
-     *         {
-     *             std::size_t parent_size = node->parent_->getVal().getSize();
-     *             std::size_t size = node->getVal().getSize();
-     *             std::size_t min_diff = std::max((std::size_t) (size * 0.002), (std::size_t) 10);
+    // nodes aren't removed, pruned tree is traversed in the same order as 
+    // in processTree, node is compared with its nearest kept ancestor as 
+    // with the parent in rejectSimilar
+    vector<Component> letters;
+    rejected_nodes_.clear();
+    traversal_stack_.clear();
+    pushChildren( root_, root_ );
+    while ( !traversal_stack_.empty() )
+    {
+        NodeId node, ancestor;
+        std::tie( node, ancestor ) = traversal_stack_.back();
+        traversal_stack_.pop_back();
 
-     *             return (parent_size - size > min_diff);
-     *         }, root_);
-     */
+        if ( !kept_nodes_[node] )
+        {
+            rejected_nodes_.push_back( node );
+            pushChildren( node, ancestor );
+            continue;
+        }
 
-    rejectSimilar();
+        if ( isDifferentFromParent( node, ancestor ) )
+        {
+            letters.push_back( tree_.getVal(node).toComponent() );
+        }
+        else
+        {
+            rejected_nodes_.push_back( node );
+        }
+        pushChildren( node, node );
+    }
 
 #ifdef PRINT_INFO
-    std::cout << "second stage after rejecting similar " << root_->getNodeCount() << endl;
+    std::cout << "second stage after rejecting similar " << letters.size() << endl;
 #endif
 
-    vector<NodeType*> nodes;
-    saveTree( root_, nodes );
-
-    ComponentExtractor extractor;
-    processTree(extractor);
-
     if ( deallocate )
     {
-        for ( NodeType * node : nodes )
-        {
-            // delete node;
-            memory_pool_allocator_.destroy(node);
-            memory_pool_allocator_.deallocate(node);
-            // memory_pool_.destroy(node);
-        }
-        // delete root_;
-        // memory_pool_.destroy(root_);
-        memory_pool_allocator_.destroy(root_);
-        memory_pool_allocator_.deallocate(root_);
-        root_ = nullptr;
+        deallocateTree();
+    }
+    else
+    {
+        // tree is left in the same state as after the separate passes
+        removeRejectedNodes();
     }
 
-    return extractor.getExtractedComponents();
+    return letters;
 }
 
-
-void ERTree::deallocateTree()
+void ERTree::pushChildren( NodeId node, NodeId ancestor )
 {
-    vector<NodeType*> nodes;
-    saveTree(root_, nodes);
-    for ( NodeType *node: nodes )
+    for ( NodeId child = tree_.getFirstChild(node); child != TreeType::k_none; 
+            child = tree_.getNext(child) )
     {
-        // delete node;
-        memory_pool_allocator_.destroy(node);
-        memory_pool_allocator_.deallocate(node);
-        // memory_pool_.destroy(node);
+        traversal_stack_.emplace_back( child, ancestor );
     }
-    // delete root_;
-    memory_pool_allocator_.destroy(root_);
-    memory_pool_allocator_.deallocate(root_);
-    // memory_pool_.destroy(root_);
-    root_ = nullptr;
 }
 
-void ERTree::saveTree( NodeType *root, std::vector<NodeType*> &nodes ) const
+void ERTree::deallocateTree()
 {
-    stack<NodeType *> stack_node;
+    tree_.clear();
+    crossing_arena_.clear();
+    root_ = TreeType::k_none;
+}
 
-    for ( NodeType *node = root->child_; node != nullptr; node = node->next_ )
+void ERTree::saveTree( NodeId root, std::vector<NodeId> &nodes ) const
+{
+    tree_.getDescendants( root, nodes );
+}
+
+void ERTree::transformExtreme()
+{
+    transform([this] (NodeId node) -> bool
+            {
+                return isExtremeRegion(node);
+            });
+}
+
+void ERTree::setSecondStageThreadCount( unsigned thread_count )
+{
+    NOCR_ASSERT( thread_count > 0, "thread count must be greater than 0" );
+    second_stage_threads_ = thread_count;
+}
+
+unsigned ERTree::getDefaultThreadCount()
+{
+    return std::max( std::thread::hardware_concurrency(), 1u );
+}
+
+void ERTree::transform2StageFiltering()
+{
+    candidate_nodes_.clear();
+    for ( NodeId node = 0; node < tree_.getSize(); ++node )
     {
-        stack_node.push(node);
+        if ( node != root_ && tree_.isAlive(node) )
+        {
+            candidate_nodes_.push_back( node );
+        }
     }
 
-    while(!stack_node.empty())
+    applyCandidateBudget();
+    classifyCandidates();
+
+    kept_nodes_.assign( tree_.getSize(), 0 );
+    for ( std::size_t i = 0; i < candidate_nodes_.size(); ++i )
     {
-        NodeType *top_stack = stack_node.top();
-        nodes.push_back(stack_node.top());
-        stack_node.pop();
+        kept_nodes_[ candidate_nodes_[i] ] = letter_decisions_[i];
+    }
 
-        for ( NodeType *node = top_stack->child_; node != nullptr; node = node->next_ )
+    // nodes over budget are rejected as well
+    rejected_nodes_.clear();
+    for ( NodeId node = 0; node < tree_.getSize(); ++node )
+    {
+        if ( node != root_ && tree_.isAlive(node) && !kept_nodes_[node] )
         {
-            stack_node.push(node);
+            rejected_nodes_.push_back( node );
         }
     }
+
+    removeRejectedNodes();
 }
 
-void ERTree::transformExtreme()
+void ERTree::applyCandidateBudget()
 {
-    transform([this] (NodeType * node) -> bool
+    if ( candidate_budget_ == 0 || candidate_nodes_.size() <= candidate_budget_ )
+    {
+        return;
+    }
+
+    ++budget_triggers_;
+
+    // ties are broken by id, so the result doesn't depend on the selection
+    std::nth_element( candidate_nodes_.begin(), 
+            candidate_nodes_.begin() + candidate_budget_, candidate_nodes_.end(),
+            [this] ( NodeId a, NodeId b )
             {
-                return isExtremeRegion(node);
-            }, root_);
+                float prob_a = tree_.getVal(a).getProbability();
+                float prob_b = tree_.getVal(b).getProbability();
+                return prob_a > prob_b || ( prob_a == prob_b && a < b );
+            });
+
+    candidate_nodes_.resize( candidate_budget_ );
+    std::sort( candidate_nodes_.begin(), candidate_nodes_.end() );
+
+#ifdef PRINT_INFO
+    std::cout << "candidate budget " << candidate_budget_ << " exceeded" << endl;
+#endif
 }
 
-void ERTree::transform2StageFiltering()
+void ERTree::classifyCandidates()
 {
-    transform([this] (NodeType * node) -> bool
+    // decisions are made on unchanged tree, char instead of bool,
+    // so workers don't share bytes
+    letter_decisions_.assign( candidate_nodes_.size(), 0 );
+    std::size_t batch_count = 
+        ( candidate_nodes_.size() + k_second_stage_batch - 1 ) / k_second_stage_batch;
+    std::atomic<std::size_t> next_batch( 0 );
+
+    auto worker = [this, batch_count, &next_batch] ()
+    {
+        for ( std::size_t b = next_batch++; b < batch_count; b = next_batch++ )
+        {
+            std::size_t begin = b * k_second_stage_batch;
+            std::size_t end = std::min( begin + k_second_stage_batch, candidate_nodes_.size() );
+            for ( std::size_t i = begin; i < end; ++i )
             {
-                return filter2_.isLetter(node->getVal());
-            }, root_);
+                letter_decisions_[i] = filter2_->isLetter( tree_.getVal( candidate_nodes_[i] ) );
+            }
+        }
+    };
+
+    std::size_t worker_count = std::min<std::size_t>( second_stage_threads_, batch_count );
+    vector< future<void> > worker_futures;
+    for ( std::size_t w = 1; w < worker_count; ++w )
+    {
+        worker_futures.push_back( std::async( std::launch::async, worker ) );
+    }
+
+    // calling thread is one of the workers
+    worker();
+    for ( auto &worker_future : worker_futures )
+    {
+        worker_future.get();
+    }
+}
+
+void ERTree::removeRejectedNodes()
+{
+    for ( NodeId node : rejected_nodes_ )
+    {
+        tree_.remove( node );
+        tree_.destroyNode( node );
+    }
 }
 
 
-bool ERTree::isExtremeRegion( NodeType *node )
+bool ERTree::isExtremeRegion( NodeId node )
 {
         auto extremeProb = findExtremeParentProb(node);
         // if nodeion is local maximum
-        float childMaxProb = node->getVal().getProbability();
+        float childMaxProb = tree_.getVal(node).getProbability();
         if (extremeProb.second <= childMaxProb) 
         {
             float local_min = extremeProb.first;
@@ -377,18 +495,17 @@ bool ERTree::isExtremeRegion( NodeType *node )
     return false;
 }
 
-pair<float,float> ERTree::findExtremeParentProb(NodeType *child_node)
+pair<float,float> ERTree::findExtremeParentProb(NodeId child_node)
 {
-    NodeType* node = child_node;
-    float prob = node->getVal().getProbability();
+    NodeId node = child_node;
+    float prob = tree_.getVal(node).getProbability();
     std::pair<float,float> output( prob, prob ); 
 
     int counter = 0;
-    while( counter < delta_ && node->parent_ )
+    while( counter < delta_ && tree_.getParent(node) != TreeType::k_none )
     {
-        node = node->parent_; 
-        // node = &records_[reg->parent_];
-        prob = node->getVal().getProbability();
+        node = tree_.getParent(node); 
+        prob = tree_.getVal(node).getProbability();
         if ( prob < output.first ) 
         {
             output.first = prob;
@@ -407,34 +524,40 @@ pair<float,float> ERTree::findExtremeParentProb(NodeType *child_node)
 
 vector<Component> ERTree::toComponent()
 {
-    vector<NodeType *> nodes;
+    vector<NodeId> nodes;
     saveTree( root_, nodes );
     vector<Component> components;
     components.reserve( nodes.size() );
-    for ( NodeType * node: nodes )
+    for ( NodeId node: nodes )
     {
-        components.push_back( node->getVal().toComponent() );
+        components.push_back( tree_.getVal(node).toComponent() );
     }
     return components;
 }
 
 void ERTree::rejectSimilar()
 {
-    transform([] (NodeType * node) -> bool
+    transform([this] (NodeId node) -> bool
             {
-                if (!node->parent_)
+                NodeId parent = tree_.getParent(node);
+                if ( parent == TreeType::k_none )
                 {
                     return true;
                 }
 
-                std::size_t parent_size = node->parent_->getVal().getSize();
-                std::size_t size = node->getVal().getSize();
-                std::size_t min_diff = ERTree::getMinSizeDiff(size);
-                // std::size_t min_diff = std::max<std::size_t>(size * 0.002, 5);
+                return isDifferentFromParent( node, parent );
+            });
 
-                return (parent_size - size > min_diff);
-            }, root_);
+}
+
+bool ERTree::isDifferentFromParent( NodeId node, NodeId parent ) const
+{
+    std::size_t parent_size = tree_.getVal(parent).getSize();
+    std::size_t size = tree_.getVal(node).getSize();
+    std::size_t min_diff = ERTree::getMinSizeDiff(size);
+    // std::size_t min_diff = std::max<std::size_t>(size * 0.002, 5);
 
+    return (parent_size - size > min_diff);
 }
 
 std::size_t ERTree::getMinSizeDiff(std::size_t size)
@@ -449,13 +572,14 @@ std::size_t ERTree::getMinSizeDiff(std::size_t size)
     }
 }
 
-bool ERTree::testSimilarChildren( NodeType *node )
+bool ERTree::testSimilarChildren( NodeId node )
 {
     const double k = 0.1;
-    int maxChildArea = node->getVal().getSize()*( 1 - k );
-    for( NodeType *child = node->child_; child != nullptr; child = child->child_ )
+    int maxChildArea = tree_.getVal(node).getSize()*( 1 - k );
+    for( NodeId child = tree_.getFirstChild(node); child != TreeType::k_none; 
+            child = tree_.getFirstChild(child) )
     {
-        if ( !checkChildren( child, maxChildArea, node->getVal().getProbability() ) )
+        if ( !checkChildren( child, maxChildArea, tree_.getVal(node).getProbability() ) )
         {
             return false;
         }
@@ -464,19 +588,20 @@ bool ERTree::testSimilarChildren( NodeType *node )
     return true;
 }
 
-bool ERTree::checkChildren( NodeType * node, int minArea, float probability )
+bool ERTree::checkChildren( NodeId node, int minArea, float probability )
 {
-    if ( node->getVal().getSize() < minArea )
+    if ( tree_.getVal(node).getSize() < minArea )
     {
         return true;
     }
 
-    if ( node->getVal().getProbability() > probability )
+    if ( tree_.getVal(node).getProbability() > probability )
     {
         return false;
     }
 
-    for( NodeType *child = node->child_; child != nullptr; child = child->child_ )
+    for( NodeId child = tree_.getFirstChild(node); child != TreeType::k_none; 
+            child = tree_.getFirstChild(child) )
     {
         if ( !checkChildren( child, minArea, probability ) )
         {
@@ -487,26 +612,27 @@ bool ERTree::checkChildren( NodeType * node, int minArea, float probability )
     return true;
 }
 
-bool ERTree::testSimilarParent(NodeType *node) 
+bool ERTree::testSimilarParent(NodeId node) 
 {
-    if ( !node->parent_ )
+    NodeId parent = tree_.getParent(node); 
+    if ( parent == TreeType::k_none )
     {
         return true;
     }
 
-    float prob = node->getVal().getProbability();
-    NodeType *parent = node->parent_; 
+    ERRegion &region = tree_.getVal(node);
+    float prob = region.getProbability();
 
-    bool parent_similarity = node->getVal().isSimilarParent( parent->getVal() );
-    while( parent->parent_ && parent_similarity ) 
+    bool parent_similarity = region.isSimilarParent( tree_.getVal(parent) );
+    while( tree_.getParent(parent) != TreeType::k_none && parent_similarity ) 
     {
-        float parent_prob = parent->getVal().getProbability();
+        float parent_prob = tree_.getVal(parent).getProbability();
         if ( parent_prob > prob )
         {
             return false;
         }
-        parent = parent->parent_; 
-        parent_similarity = node->getVal().isSimilarParent( parent->getVal() );
+        parent = tree_.getParent(parent); 
+        parent_similarity = region.isSimilarParent( tree_.getVal(parent) );
     }
 
     return true;
@@ -514,14 +640,14 @@ bool ERTree::testSimilarParent(NodeType *node)
 
 std::vector< std::vector<float> > ERTree::getAllFirstStageDesc() const
 {
-    std::vector<NodeType *> nodes;
+    std::vector<NodeId> nodes;
     saveTree( root_, nodes );
 
     vector< vector<float> > first_stage_desc;
     first_stage_desc.reserve( nodes.size() );
-    for ( NodeType *node : nodes )
+    for ( NodeId node : nodes )
     {
-        first_stage_desc.push_back( node->getVal().getFeatures() );
+        first_stage_desc.push_back( tree_.getVal(node).getFeatures() );
     }
 
     return first_stage_desc;
@@ -545,21 +671,67 @@ ERTextDetection::ERTextDetection
 auto ERTextDetection::getLetters( const cv::Mat &image ) 
     -> vector<Storage>
 {
-    double min_area_ratio;
-    double max_area_ratio;
+    return getLetters( image, image.size() );
+}
+
+auto ERTextDetection::getLetters( const cv::Mat &image, const cv::Size &domain_size ) 
+    -> vector<Storage>
+{
+    if ( parallel_polarity_ )
+    {
+        return getLettersParallel( image, domain_size );
+    }
+
+    bool truncated = false;
+    return getLettersSerial( image, domain_size, Deadline(), truncated );
+}
+
+auto ERTextDetection::getLetters( const cv::Mat &image, const cv::Rect &roi ) 
+    -> vector<Storage>
+{
+    // submatrix shares data with image
+    auto roi_letters = getLetters( image( roi ), image.size() );
+
+    vector<Storage> letters;
+    letters.reserve( roi_letters.size() );
+    for ( const Storage &letter : roi_letters )
+    {
+        letters.push_back( translated( letter, roi.tl() ) );
+    }
+
+    return letters;
+}
+
+auto ERTextDetection::getLetters( const cv::Mat &image, const Deadline &deadline, 
+        bool &truncated ) 
+    -> vector<Storage>
+{
+    if ( parallel_polarity_ )
+    {
+        return getLettersParallel( image, image.size() );
+    }
 
-    std::tie(min_area_ratio, max_area_ratio) = ErLimitSize::getErSizeLimits(image.size());
-    extremal_region_.setMinAreaRatio(min_area_ratio);
-    extremal_region_.setMaxAreaRatio(max_area_ratio);
-    extremal_region_.setImage( image );
+    return getLettersSerial( image, image.size(), deadline, truncated );
+}
+
+auto ERTextDetection::getLettersSerial( const cv::Mat &image, const cv::Size &domain_size, 
+        const Deadline &deadline, bool &truncated ) 
+    -> vector<Storage>
+{
+    setUpTree( workspace_, image, domain_size );
 
-    ComponentTreeBuilder<ERTree> builder( &extremal_region_ );
     // ComponentTreeNode<ERRegion> *root = builder.buildTree();
-    builder.buildTree();
+    workspace_.buildTree();
     auto letters_storages = extremal_region_.getLetters(); 
+    if ( deadline.expired() )
+    {
+        truncated = true;
+        return letters_storages;
+    }
+
     extremal_region_.invertDomain();
 
-    builder.buildTree();
+    workspace_.buildTree();
     auto tmp = extremal_region_.getLetters();
     letters_storages.reserve( letters_storages.size() + tmp.size() );
     letters_storages.insert( letters_storages.end(), tmp.begin(), tmp.end() );
@@ -567,6 +739,52 @@ auto ERTextDetection::getLetters( const cv::Mat &image )
     return letters_storages;
 }
 
+void ERTextDetection::setUpTree( ERWorkspace &workspace, const cv::Mat &image, 
+        const cv::Size &domain_size )
+{
+    double min_area_ratio;
+    double max_area_ratio;
+
+    std::tie(min_area_ratio, max_area_ratio) = ErLimitSize::getErSizeLimits(domain_size);
+
+    // ratios are relative to the area of processed image
+    double area_scale = (double) domain_size.area() / image.size().area();
+    workspace.getTree().setMinAreaRatio(min_area_ratio * area_scale);
+    workspace.getTree().setMaxAreaRatio(max_area_ratio * area_scale);
+    workspace.setImage( image );
+}
+
+auto ERTextDetection::extractLetters( ERWorkspace &workspace )
+    -> vector<Storage>
+{
+    workspace.buildTree();
+    return workspace.getTree().getLetters();
+}
+
+auto ERTextDetection::getLettersParallel( const cv::Mat &image, 
+        const cv::Size &domain_size )
+    -> vector<Storage>
+{
+    inverted_region_.shareConfiguration( extremal_region_ );
+
+    setUpTree( workspace_, image, domain_size );
+    setUpTree( inverted_workspace_, image, domain_size );
+    inverted_region_.invertDomain();
+
+    auto inverted_letters = std::async( std::launch::async, [this] () 
+            {
+                return extractLetters( inverted_workspace_ );
+            });
+
+    auto letters_storages = extractLetters( workspace_ );
+    auto tmp = inverted_letters.get();
+
+    letters_storages.reserve( letters_storages.size() + tmp.size() );
+    letters_storages.insert( letters_storages.end(), tmp.begin(), tmp.end() );
+
+    return letters_storages;
+}
+
 void ComponentExtractor::operator() (const ERRegion & er_region)
 {
     extracted_components_.push_back(er_region.toComponent());
@@ -577,6 +795,43 @@ std::vector<Component> ComponentExtractor::getExtractedComponents() const
     return extracted_components_;
 }
 
+std::vector<Component> ErDuplicateFilter::filter(const std::vector< std::vector<Component> > & components)
+{
+    typedef std::tuple<int, int, int, int, int> Key;
+    auto getKey = [] ( const Component * c ) -> Key
+    {
+        return Key( c->getLeft(), c->getUpper(), c->getRight(), c->getLower(), c->size() );
+    };
+
+    std::vector<const Component *> all_components;
+    for ( const auto & part : components )
+    {
+        for ( const auto & c : part )
+        {
+            all_components.push_back( &c );
+        }
+    }
+
+    std::stable_sort( all_components.begin(), all_components.end(),
+            [&getKey] ( const Component * a, const Component * b )
+            {
+                return getKey(a) < getKey(b);
+            });
+
+    std::vector<Component> output;
+    output.reserve( all_components.size() );
+    for ( std::size_t i = 0; i < all_components.size(); ++i )
+    {
+        if ( i > 0 && getKey( all_components[i] ) == getKey( all_components[i - 1] ) )
+        {
+            continue;
+        }
+        output.push_back( *all_components[i] );
+    }
+
+    return output;
+}
+
 std::pair<double, double> ErLimitSize::getErSizeLimits(const cv::Size & size)
 {
     double min_area_ratio = 0.000035;
@@ -11,11 +11,31 @@
 #include <limits>
 #include <algorithm>
 #include <tuple>
+#include <cmath>
 #include <fstream>
 #include <sstream>
+#include <cstring>
+#include <cstdint>
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
 
 #include <pugi/pugixml.hpp>
 
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+// avx2 code is compiled by target attribute and selected at runtime
+#if defined(__GNUC__) && ( defined(__x86_64__) || defined(__i386__) )
+#define NOCR_IKSVM_AVX2 1
+#include <immintrin.h>
+#else
+#define NOCR_IKSVM_AVX2 0
+#endif
+
 #define DEBUG 0
 #define FAST_EVAL 1
 
@@ -52,6 +72,123 @@ std::string toString(const std::vector<T> & values, char delim = ' ')
     return ss.str();
 }
 
+///binary format
+//
+// Binary model starts with BinaryHeader followed by sections with prob A,
+// prob B, labels, b of decision functions (doubles) and block tables
+// (floats) in native byte order, every section is aligned to 64 bytes.
+// Quantized model has block scales (floats) and quantized values instead 
+// of float values. Version 1 has no quantization, its header is shorter,
+// but padding of header reads as IKSVMQuantization::none.
+
+namespace
+{
+
+const char k_binary_magic[8] = { 'N', 'O', 'C', 'R', 'I', 'K', 'S', 'V' };
+const std::uint32_t k_binary_version = 2;
+const std::uint32_t k_byte_order = 0x01020304;
+const std::size_t k_section_alignment = 64;
+
+// avx2 gathers of quantized values read 4 bytes from the position of the last value
+const std::size_t k_quantized_padding = 4;
+
+std::size_t quantizedValueSize( IKSVMQuantization quantization )
+{
+    switch ( quantization )
+    {
+        case IKSVMQuantization::int16:
+            return sizeof(std::int16_t);
+        case IKSVMQuantization::int8:
+            return sizeof(std::int8_t);
+        default:
+            return 0;
+    }
+}
+
+struct BinaryHeader
+{
+    char magic[8];
+    std::uint32_t version;
+    std::uint32_t byte_order;
+    std::uint32_t block_size;
+    std::int32_t nr_class;
+    std::int32_t features_dim;
+    std::int32_t approx_count;
+    std::int32_t quantization;
+    std::uint32_t reserved;
+};
+
+struct BinaryLayout
+{
+    std::size_t prob_A, prob_B, labels, b, block_info, block_scales, block_values, end;
+
+    BinaryLayout( const BinaryHeader &header )
+    {
+        std::size_t number_subproblems = header.nr_class * (header.nr_class - 1) / 2;
+        std::size_t num_blocks = (number_subproblems + header.block_size - 1) / header.block_size;
+        std::size_t info_size = num_blocks * header.features_dim * 2 * header.block_size;
+        std::size_t scales_size = 0;
+        std::size_t values_bytes = num_blocks * header.features_dim * header.block_size 
+            * 2 * header.approx_count * sizeof(float);
+
+        auto quantization = static_cast<IKSVMQuantization>( header.quantization );
+        if ( quantization != IKSVMQuantization::none )
+        {
+            scales_size = num_blocks * 2 * header.block_size;
+            values_bytes = num_blocks * header.features_dim * header.block_size 
+                * (header.approx_count + 1) * quantizedValueSize( quantization ) 
+                + k_quantized_padding;
+        }
+
+        prob_A = align( sizeof(BinaryHeader) );
+        prob_B = align( prob_A + number_subproblems * sizeof(double) );
+        labels = align( prob_B + number_subproblems * sizeof(double) );
+        b = align( labels + header.nr_class * sizeof(double) );
+        block_info = align( b + number_subproblems * sizeof(double) );
+        block_scales = align( block_info + info_size * sizeof(float) );
+        block_values = align( block_scales + scales_size * sizeof(float) );
+        end = block_values + values_bytes;
+    }
+
+    static std::size_t align( std::size_t offset )
+    {
+        return (offset + k_section_alignment - 1) / k_section_alignment * k_section_alignment;
+    }
+};
+
+// read only shared mapping, pages are shared by all processes mapping the file
+std::shared_ptr<const void> mapFile( const std::string &file_name, std::size_t &size )
+{
+    int fd = open( file_name.c_str(), O_RDONLY );
+    if ( fd < 0 )
+    {
+        throw FileNotFoundException( file_name + " iksvm binary file not found" );
+    }
+
+    struct stat file_stat;
+    if ( fstat( fd, &file_stat ) != 0 || file_stat.st_size == 0 )
+    {
+        close( fd );
+        throw BadFileFormatting( file_name + " can't be mapped" );
+    }
+
+    size = file_stat.st_size;
+    void *data = mmap( nullptr, size, PROT_READ, MAP_SHARED, fd, 0 );
+    close( fd );
+    if ( data == MAP_FAILED )
+    {
+        throw BadFileFormatting( file_name + " can't be mapped" );
+    }
+
+    std::size_t mapped_size = size;
+    return std::shared_ptr<const void>( data, [mapped_size] ( const void *ptr )
+            {
+                munmap( const_cast<void *>( ptr ), mapped_size );
+            });
+}
+
+}
+
 
 
 
@@ -303,6 +440,13 @@ IKSVM IKSVMConvertor::createFromSvmProblem( svm_model *model, int num_segment )
     return IKSVM( nr_class_, features_dim_, num_segment, prob_a, prob_b, desicion_functions, labels ); 
 }
 
+IKSVM IKSVMConvertor::quantize( const IKSVM &model, IKSVMQuantization quantization )
+{
+    IKSVM quantized = model;
+    quantized.quantizeBlockTables( quantization );
+    return quantized;
+}
+
 vector<int> IKSVMConvertor::getStartsOfSv()
 {
     vector<int> start( nr_class_, 0 );
@@ -474,10 +618,15 @@ IKSVM::IKSVM( int nr_class, int features_dim, int approx_count,
         decision_function_.insert(decision_function_.end(),
                 values.begin(), values.end());
     }
+
+    buildBlockTables();
 }
 
 void IKSVM::save( const std::string &file_name )
 {
+    NOCR_ASSERT( !decision_function_.empty() || nr_class_ == 0, 
+            "model loaded from binary file can't be saved in text format" );
+
     std::ofstream ofs( file_name );
 
     /*
@@ -634,6 +783,15 @@ void IKSVM::load( const std::string &file_name )
         throw FileNotFoundException( file_name + "iksvm configuration file not found" );
     }
 
+    char magic[sizeof(k_binary_magic)];
+    if ( ifs.read(magic, sizeof(magic)) && std::equal(magic, magic + sizeof(magic), k_binary_magic) )
+    {
+        ifs.close();
+        loadBinary(file_name);
+        return;
+    }
+    ifs.clear();
+    ifs.seekg(0);
 
     std::string line;
 
@@ -673,6 +831,8 @@ void IKSVM::load( const std::string &file_name )
         }
     }
 
+    buildBlockTables();
+    setEvaluator(evaluator_);
 }
 
 void IKSVM::parseDecisionFunction(const std::string & line, std::size_t indx)
@@ -757,145 +917,982 @@ vector<double> IKSVM::strToVec( const std::string &s )
     return output;
 }
  
-// ====================predicting =======================================
+// ====================vectorized evaluation=============================
 //
+// Decision functions are evaluated in blocks of k_block_size classifiers,
+// tables of one block are used for all descriptors before the next block,
+// so they stay in cache. Position in approximated function is clamped
+// to [0, num_steps] before interpolation, it gives the same values
+// as clamping of indices in IKSVM::evalDecisionFunction. Terms are computed
+// in float and summed in double in the same order by all evaluators,
+// so they return equal decision values.
+
+namespace
+{
+
+const int k_block_size = 8;
 
-double IKSVM::predict( const std::vector<double> &x )
+struct BlockTables
 {
-    std::vector<double> decision_values;
-    return computeDecisionsValue(x, decision_values );
+    const float *info;
+    const float *values;
+    int features_dim;
+    int approx_count;
+    std::size_t num_blocks;
+};
+
+inline float laneTerm( const float *info, const float *values, int lane, float x_i, 
+        float max_position, std::size_t values_stride )
+{
+    float position = ( x_i - info[k_block_size + lane] ) * info[lane];
+    position = position > 0.0f ? position : 0.0f;
+    position = position < max_position ? position : max_position;
+
+    int left = position;
+    float alpha = position - left;
+    const float *value = values + lane * values_stride + 2 * left;
+    return value[0] + alpha * value[1];
 }
-         
-std::vector<double> IKSVM::predictMultiple(const std::vector<double> &x)
+
+// sum of terms of one classifier p, equal to its sum from block evaluators
+double evalLane( const BlockTables &tables, std::size_t p, const double *x )
 {
-    std::vector<double> decision_values;
-    return computeDecisionsValueMult(x, decision_values);
+    float max_position = tables.approx_count - 1;
+    std::size_t values_stride = 2 * tables.approx_count;
+    std::size_t b = p / k_block_size;
+    int lane = p % k_block_size;
+    const float *block_info = tables.info + b * tables.features_dim * 2 * k_block_size;
+    const float *block_values = tables.values 
+        + b * tables.features_dim * k_block_size * values_stride;
+
+    double sum = 0;
+    for ( int i = 0; i < tables.features_dim; ++i )
+    {
+        sum += laneTerm( block_info + i * 2 * k_block_size, 
+                block_values + i * k_block_size * values_stride, 
+                lane, x[i], max_position, values_stride );
+    }
+    return sum;
 }
 
-double IKSVM::computeDecisionsValue( const std::vector<double> &x, 
-        std::vector<double> &decision_values )
+// sums has k_block_size * num_blocks values for every descriptor in x
+void evalBlocksScalar( const BlockTables &tables, const double *x, std::size_t count, 
+        double *sums )
 {
-    decision_values.resize(nr_class_ * (nr_class_ - 1 ) / 2);
-    std::vector<int> votes( nr_class_, 0 );
-    int p = 0;
-    for ( int i = 0; i < nr_class_; ++i ) 
+    float max_position = tables.approx_count - 1;
+    std::size_t values_stride = 2 * tables.approx_count;
+    for ( std::size_t b = 0; b < tables.num_blocks; ++b )
     {
-        for ( int j = i + 1; j < nr_class_; ++j )
+        const float *block_info = tables.info + b * tables.features_dim * 2 * k_block_size;
+        const float *block_values = tables.values 
+            + b * tables.features_dim * k_block_size * values_stride;
+
+        for ( std::size_t k = 0; k < count; ++k )
         {
-            double decision_value = evalDecisionFunction(p, x);
-            decision_values[p] = decision_value;
+            const double *descriptor = x + k * tables.features_dim;
+            double *block_sums = sums + ( k * tables.num_blocks + b ) * k_block_size;
+            std::fill( block_sums, block_sums + k_block_size, 0.0 );
 
-            if ( decision_value > 0 )
+            for ( int i = 0; i < tables.features_dim; ++i )
             {
-                votes[i] += 1;
+                const float *info = block_info + i * 2 * k_block_size;
+                const float *values = block_values + i * k_block_size * values_stride;
+                float x_i = descriptor[i];
+
+                for ( int lane = 0; lane < k_block_size; ++lane )
+                {
+                    block_sums[lane] += laneTerm( info, values, lane, x_i, 
+                            max_position, values_stride );
+                }
             }
-            else 
+        }
+    }
+}
+
+#if defined(__SSE2__)
+void evalBlocksSse2( const BlockTables &tables, const double *x, std::size_t count, 
+        double *sums )
+{
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 max_position = _mm_set1_ps( tables.approx_count - 1 );
+    std::size_t values_stride = 2 * tables.approx_count;
+    for ( std::size_t b = 0; b < tables.num_blocks; ++b )
+    {
+        const float *block_info = tables.info + b * tables.features_dim * 2 * k_block_size;
+        const float *block_values = tables.values 
+            + b * tables.features_dim * k_block_size * values_stride;
+
+        for ( std::size_t k = 0; k < count; ++k )
+        {
+            const double *descriptor = x + k * tables.features_dim;
+            __m128d block_sums[k_block_size / 2];
+            for ( auto &block_sum : block_sums )
             {
-                votes[j] += 1;
+                block_sum = _mm_setzero_pd();
+            }
+
+            for ( int i = 0; i < tables.features_dim; ++i )
+            {
+                const float *info = block_info + i * 2 * k_block_size;
+                const float *values = block_values + i * k_block_size * values_stride;
+                __m128 x_i = _mm_set1_ps( descriptor[i] );
+
+                for ( int half = 0; half < k_block_size; half += 4 )
+                {
+                    __m128 position = _mm_mul_ps( 
+                            _mm_sub_ps( x_i, _mm_loadu_ps( info + k_block_size + half ) ),
+                            _mm_loadu_ps( info + half ) );
+                    position = _mm_min_ps( _mm_max_ps( position, zero ), max_position );
+
+                    __m128i left = _mm_cvttps_epi32( position );
+                    __m128 alpha = _mm_sub_ps( position, _mm_cvtepi32_ps( left ) );
+
+                    // sse2 has no gather
+                    int lefts[4];
+                    _mm_storeu_si128( reinterpret_cast<__m128i *>( lefts ), left );
+                    const float *lane_values = values + half * values_stride;
+                    const float *v0 = lane_values + 2 * lefts[0];
+                    const float *v1 = lane_values + values_stride + 2 * lefts[1];
+                    const float *v2 = lane_values + 2 * values_stride + 2 * lefts[2];
+                    const float *v3 = lane_values + 3 * values_stride + 2 * lefts[3];
+                    __m128 value = _mm_setr_ps( v0[0], v1[0], v2[0], v3[0] );
+                    __m128 difference = _mm_setr_ps( v0[1], v1[1], v2[1], v3[1] );
+
+                    __m128 term = _mm_add_ps( value, _mm_mul_ps( alpha, difference ) );
+                    block_sums[half / 2] = _mm_add_pd( block_sums[half / 2], 
+                            _mm_cvtps_pd( term ) );
+                    block_sums[half / 2 + 1] = _mm_add_pd( block_sums[half / 2 + 1], 
+                            _mm_cvtps_pd( _mm_movehl_ps( term, term ) ) );
+                }
+            }
+
+            double *output = sums + ( k * tables.num_blocks + b ) * k_block_size;
+            for ( int j = 0; j < k_block_size / 2; ++j )
+            {
+                _mm_storeu_pd( output + 2 * j, block_sums[j] );
             }
-            ++p;
         }
     }
+}
+#endif
 
-    size_t max_idx = 0;
-    for ( size_t i = 1; i < votes.size(); ++i ) 
+#if NOCR_IKSVM_AVX2
+__attribute__((target("avx2")))
+void evalBlocksAvx2( const BlockTables &tables, const double *x, std::size_t count, 
+        double *sums )
+{
+    const __m256 zero = _mm256_setzero_ps();
+    const __m256 max_position = _mm256_set1_ps( tables.approx_count - 1 );
+    int values_stride = 2 * tables.approx_count;
+    const __m256i lane_offsets = _mm256_mullo_epi32( _mm256_set1_epi32( values_stride ),
+            _mm256_setr_epi32( 0, 1, 2, 3, 4, 5, 6, 7 ) );
+    for ( std::size_t b = 0; b < tables.num_blocks; ++b )
     {
-        if ( votes[max_idx] < votes[i] )
+        const float *block_info = tables.info + b * tables.features_dim * 2 * k_block_size;
+        const float *block_values = tables.values 
+            + b * tables.features_dim * k_block_size * values_stride;
+
+        for ( std::size_t k = 0; k < count; ++k )
         {
-            max_idx = i;
+            const double *descriptor = x + k * tables.features_dim;
+            __m256d low_sums = _mm256_setzero_pd();
+            __m256d high_sums = _mm256_setzero_pd();
+
+            for ( int i = 0; i < tables.features_dim; ++i )
+            {
+                const float *info = block_info + i * 2 * k_block_size;
+                const float *values = block_values + i * k_block_size * values_stride;
+
+                __m256 position = _mm256_mul_ps( 
+                        _mm256_sub_ps( _mm256_set1_ps( descriptor[i] ), 
+                            _mm256_loadu_ps( info + k_block_size ) ),
+                        _mm256_loadu_ps( info ) );
+                position = _mm256_min_ps( _mm256_max_ps( position, zero ), max_position );
+
+                __m256i left = _mm256_cvttps_epi32( position );
+                __m256 alpha = _mm256_sub_ps( position, _mm256_cvtepi32_ps( left ) );
+
+                __m256i indices = _mm256_add_epi32( lane_offsets, _mm256_slli_epi32( left, 1 ) );
+                __m256 value = _mm256_i32gather_ps( values, indices, 4 );
+                __m256 difference = _mm256_i32gather_ps( values + 1, indices, 4 );
+
+                __m256 term = _mm256_add_ps( value, _mm256_mul_ps( alpha, difference ) );
+                low_sums = _mm256_add_pd( low_sums, 
+                        _mm256_cvtps_pd( _mm256_castps256_ps128( term ) ) );
+                high_sums = _mm256_add_pd( high_sums, 
+                        _mm256_cvtps_pd( _mm256_extractf128_ps( term, 1 ) ) );
+            }
+
+            double *output = sums + ( k * tables.num_blocks + b ) * k_block_size;
+            _mm256_storeu_pd( output, low_sums );
+            _mm256_storeu_pd( output + 4, high_sums );
         }
     }
-    return labels_[max_idx];
 }
+#endif
+
+// Quantized tables have approx_count + 1 values for every classifier and
+// feature, the last value is repeated, so interpolation reads two neighbouring
+// values. Classifier value of feature is offset + scale * quantized value,
+// so the sum of quantized terms is dequantized once per classifier.
 
-std::vector<double> IKSVM::computeDecisionsValueMult(const std::vector<double> & descriptors,
-        std::vector<double> & decision_values)
+struct QuantizedTables
 {
-    std::size_t count = descriptors.size()/features_dim_;
-    std::size_t num_classifiers = nr_class_ * (nr_class_ - 1 ) / 2;
+    const float *info;
+    const void *values;
+    int features_dim;
+    int approx_count;
+    std::size_t num_blocks;
+};
+
+template <typename Q>
+inline float quantizedLaneTerm( const float *info, const Q *values, int lane, float x_i, 
+        float max_position, std::size_t values_stride )
+{
+    float position = ( x_i - info[k_block_size + lane] ) * info[lane];
+    position = position > 0.0f ? position : 0.0f;
+    position = position < max_position ? position : max_position;
+
+    int left = position;
+    float alpha = position - left;
+    const Q *value = values + lane * values_stride + left;
+    float left_value = value[0];
+    float right_value = value[1];
+    return left_value + alpha * ( right_value - left_value );
+}
 
-    decision_values.resize(count * num_classifiers);
-    vector<int> votes(count * nr_class_, 0);
+template <typename Q>
+double evalQuantizedLane( const QuantizedTables &tables, std::size_t p, const double *x )
+{
+    float max_position = tables.approx_count - 1;
+    std::size_t values_stride = tables.approx_count + 1;
+    std::size_t b = p / k_block_size;
+    int lane = p % k_block_size;
+    const float *block_info = tables.info + b * tables.features_dim * 2 * k_block_size;
+    const Q *block_values = static_cast<const Q *>( tables.values ) 
+        + b * tables.features_dim * k_block_size * values_stride;
+
+    double sum = 0;
+    for ( int i = 0; i < tables.features_dim; ++i )
+    {
+        sum += quantizedLaneTerm( block_info + i * 2 * k_block_size, 
+                block_values + i * k_block_size * values_stride, 
+                lane, x[i], max_position, values_stride );
+    }
+    return sum;
+}
 
-    int p = 0;
-    for ( int i = 0; i < nr_class_; ++i ) 
+template <typename Q>
+void evalQuantizedBlocksScalar( const QuantizedTables &tables, const double *x, 
+        std::size_t count, double *sums )
+{
+    float max_position = tables.approx_count - 1;
+    std::size_t values_stride = tables.approx_count + 1;
+    for ( std::size_t b = 0; b < tables.num_blocks; ++b )
     {
-        for ( int j = i + 1; j < nr_class_; ++j )
+        const float *block_info = tables.info + b * tables.features_dim * 2 * k_block_size;
+        const Q *block_values = static_cast<const Q *>( tables.values ) 
+            + b * tables.features_dim * k_block_size * values_stride;
+
+        for ( std::size_t k = 0; k < count; ++k )
         {
-            for (std::size_t k = 0; k < count; ++k)
+            const double *descriptor = x + k * tables.features_dim;
+            double *block_sums = sums + ( k * tables.num_blocks + b ) * k_block_size;
+            std::fill( block_sums, block_sums + k_block_size, 0.0 );
+
+            for ( int i = 0; i < tables.features_dim; ++i )
             {
-                double decision_value = evalDecisionFunction(p, descriptors, k * features_dim_);
-                decision_values[k * num_classifiers + p] = decision_value;
+                const float *info = block_info + i * 2 * k_block_size;
+                const Q *values = block_values + i * k_block_size * values_stride;
+                float x_i = descriptor[i];
 
-                if ( decision_value > 0 )
+                for ( int lane = 0; lane < k_block_size; ++lane )
                 {
-                    votes[k * nr_class_ + i] += 1;
+                    block_sums[lane] += quantizedLaneTerm( info, values, lane, x_i, 
+                            max_position, values_stride );
                 }
-                else 
+            }
+        }
+    }
+}
+
+#if defined(__SSE2__)
+template <typename Q>
+void evalQuantizedBlocksSse2( const QuantizedTables &tables, const double *x, 
+        std::size_t count, double *sums )
+{
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 max_position = _mm_set1_ps( tables.approx_count - 1 );
+    std::size_t values_stride = tables.approx_count + 1;
+    for ( std::size_t b = 0; b < tables.num_blocks; ++b )
+    {
+        const float *block_info = tables.info + b * tables.features_dim * 2 * k_block_size;
+        const Q *block_values = static_cast<const Q *>( tables.values ) 
+            + b * tables.features_dim * k_block_size * values_stride;
+
+        for ( std::size_t k = 0; k < count; ++k )
+        {
+            const double *descriptor = x + k * tables.features_dim;
+            __m128d block_sums[k_block_size / 2];
+            for ( auto &block_sum : block_sums )
+            {
+                block_sum = _mm_setzero_pd();
+            }
+
+            for ( int i = 0; i < tables.features_dim; ++i )
+            {
+                const float *info = block_info + i * 2 * k_block_size;
+                const Q *values = block_values + i * k_block_size * values_stride;
+                __m128 x_i = _mm_set1_ps( descriptor[i] );
+
+                for ( int half = 0; half < k_block_size; half += 4 )
                 {
-                    votes[k * nr_class_ + j] += 1;
+                    __m128 position = _mm_mul_ps( 
+                            _mm_sub_ps( x_i, _mm_loadu_ps( info + k_block_size + half ) ),
+                            _mm_loadu_ps( info + half ) );
+                    position = _mm_min_ps( _mm_max_ps( position, zero ), max_position );
+
+                    __m128i left = _mm_cvttps_epi32( position );
+                    __m128 alpha = _mm_sub_ps( position, _mm_cvtepi32_ps( left ) );
+
+                    int lefts[4];
+                    _mm_storeu_si128( reinterpret_cast<__m128i *>( lefts ), left );
+                    const Q *lane_values = values + half * values_stride;
+                    const Q *v0 = lane_values + lefts[0];
+                    const Q *v1 = lane_values + values_stride + lefts[1];
+                    const Q *v2 = lane_values + 2 * values_stride + lefts[2];
+                    const Q *v3 = lane_values + 3 * values_stride + lefts[3];
+                    __m128 left_value = _mm_setr_ps( v0[0], v1[0], v2[0], v3[0] );
+                    __m128 right_value = _mm_setr_ps( v0[1], v1[1], v2[1], v3[1] );
+
+                    __m128 term = _mm_add_ps( left_value, 
+                            _mm_mul_ps( alpha, _mm_sub_ps( right_value, left_value ) ) );
+                    block_sums[half / 2] = _mm_add_pd( block_sums[half / 2], 
+                            _mm_cvtps_pd( term ) );
+                    block_sums[half / 2 + 1] = _mm_add_pd( block_sums[half / 2 + 1], 
+                            _mm_cvtps_pd( _mm_movehl_ps( term, term ) ) );
                 }
-            } 
+            }
 
-            ++p;
+            double *output = sums + ( k * tables.num_blocks + b ) * k_block_size;
+            for ( int j = 0; j < k_block_size / 2; ++j )
+            {
+                _mm_storeu_pd( output + 2 * j, block_sums[j] );
+            }
         }
     }
+}
+#endif
 
-    vector<double> results(count);
+#if NOCR_IKSVM_AVX2
+// one 32 bit gather loads both neighbouring values, they are sign extended
+// from the lowest bytes
+template <typename Q>
+__attribute__((target("avx2")))
+void evalQuantizedBlocksAvx2( const QuantizedTables &tables, const double *x, 
+        std::size_t count, double *sums )
+{
+    const int value_bits = 8 * sizeof(Q);
+    const __m256 zero = _mm256_setzero_ps();
+    const __m256 max_position = _mm256_set1_ps( tables.approx_count - 1 );
+    int values_stride = tables.approx_count + 1;
+    const __m256i lane_offsets = _mm256_mullo_epi32( 
+            _mm256_set1_epi32( values_stride * sizeof(Q) ),
+            _mm256_setr_epi32( 0, 1, 2, 3, 4, 5, 6, 7 ) );
+    for ( std::size_t b = 0; b < tables.num_blocks; ++b )
+    {
+        const float *block_info = tables.info + b * tables.features_dim * 2 * k_block_size;
+        const Q *block_values = static_cast<const Q *>( tables.values ) 
+            + b * tables.features_dim * k_block_size * values_stride;
 
-    std::size_t offset = 0;
-    for (std::size_t k = 0; k < count; ++k)
+        for ( std::size_t k = 0; k < count; ++k )
+        {
+            const double *descriptor = x + k * tables.features_dim;
+            __m256d low_sums = _mm256_setzero_pd();
+            __m256d high_sums = _mm256_setzero_pd();
+
+            for ( int i = 0; i < tables.features_dim; ++i )
+            {
+                const float *info = block_info + i * 2 * k_block_size;
+                const Q *values = block_values + i * k_block_size * values_stride;
+
+                __m256 position = _mm256_mul_ps( 
+                        _mm256_sub_ps( _mm256_set1_ps( descriptor[i] ), 
+                            _mm256_loadu_ps( info + k_block_size ) ),
+                        _mm256_loadu_ps( info ) );
+                position = _mm256_min_ps( _mm256_max_ps( position, zero ), max_position );
+
+                __m256i left = _mm256_cvttps_epi32( position );
+                __m256 alpha = _mm256_sub_ps( position, _mm256_cvtepi32_ps( left ) );
+
+                __m256i byte_offsets = _mm256_add_epi32( lane_offsets, 
+                        _mm256_mullo_epi32( left, _mm256_set1_epi32( sizeof(Q) ) ) );
+                __m256i gathered = _mm256_i32gather_epi32( 
+                        reinterpret_cast<const int *>( values ), byte_offsets, 1 );
+                __m256i left_q = _mm256_srai_epi32( 
+                        _mm256_slli_epi32( gathered, 32 - value_bits ), 32 - value_bits );
+                __m256i right_q = _mm256_srai_epi32( 
+                        _mm256_slli_epi32( gathered, 32 - 2 * value_bits ), 32 - value_bits );
+                __m256 left_value = _mm256_cvtepi32_ps( left_q );
+                __m256 right_value = _mm256_cvtepi32_ps( right_q );
+
+                __m256 term = _mm256_add_ps( left_value, 
+                        _mm256_mul_ps( alpha, _mm256_sub_ps( right_value, left_value ) ) );
+                low_sums = _mm256_add_pd( low_sums, 
+                        _mm256_cvtps_pd( _mm256_castps256_ps128( term ) ) );
+                high_sums = _mm256_add_pd( high_sums, 
+                        _mm256_cvtps_pd( _mm256_extractf128_ps( term, 1 ) ) );
+            }
+
+            double *output = sums + ( k * tables.num_blocks + b ) * k_block_size;
+            _mm256_storeu_pd( output, low_sums );
+            _mm256_storeu_pd( output + 4, high_sums );
+        }
+    }
+}
+#endif
+
+template <typename Q>
+void quantizeValues( const float *block_values, std::size_t num_blocks, int features_dim, 
+        int approx_count, float *scales, Q *quantized )
+{
+    const int max_quantized = std::numeric_limits<Q>::max();
+    std::size_t values_stride = 2 * approx_count;
+    std::size_t quantized_stride = approx_count + 1;
+    for ( std::size_t b = 0; b < num_blocks; ++b )
     {
-        std::size_t max_idx = 0;
-        for (std::size_t i = 1; i < nr_class_; ++i)
+        for ( int lane = 0; lane < k_block_size; ++lane )
         {
-            if (votes[offset + max_idx] < votes[offset + i])
+            auto value = [&] ( int i, int k )
+            {
+                return block_values[( ( b * features_dim + i ) * k_block_size + lane ) 
+                    * values_stride + 2 * k];
+            };
+
+            float min_value = value( 0, 0 ), max_value = value( 0, 0 );
+            for ( int i = 0; i < features_dim; ++i )
+            {
+                for ( int k = 0; k < approx_count; ++k )
+                {
+                    min_value = std::min( min_value, value( i, k ) );
+                    max_value = std::max( max_value, value( i, k ) );
+                }
+            }
+
+            float offset = ( min_value + max_value ) / 2;
+            float scale = ( max_value - min_value ) / ( 2 * max_quantized );
+            scale = scale > 0 ? scale : 1;
+            scales[b * 2 * k_block_size + lane] = scale;
+            // offsets of all features are added at once
+            scales[b * 2 * k_block_size + k_block_size + lane] = offset * features_dim;
+
+            for ( int i = 0; i < features_dim; ++i )
             {
-                max_idx = i;
+                Q *output = quantized 
+                    + ( ( b * features_dim + i ) * k_block_size + lane ) * quantized_stride;
+                for ( int k = 0; k < approx_count; ++k )
+                {
+                    long q = std::lround( ( value( i, k ) - offset ) / scale );
+                    output[k] = std::max<long>( -max_quantized, std::min<long>( q, max_quantized ) );
+                }
+                output[approx_count] = output[approx_count - 1];
             }
         }
+    }
+}
 
-        results[k] = labels_[max_idx];
-        offset += nr_class_;
+template <typename Q>
+void evalQuantizedBlocks( IKSVM::Evaluator evaluator, const QuantizedTables &tables, 
+        const double *x, std::size_t count, double *sums )
+{
+    switch ( evaluator )
+    {
+#if NOCR_IKSVM_AVX2
+        case IKSVM::Evaluator::avx2:
+            evalQuantizedBlocksAvx2<Q>( tables, x, count, sums );
+            break;
+#endif
+#if defined(__SSE2__)
+        case IKSVM::Evaluator::sse2:
+            evalQuantizedBlocksSse2<Q>( tables, x, count, sums );
+            break;
+#endif
+        default:
+            evalQuantizedBlocksScalar<Q>( tables, x, count, sums );
+            break;
     }
+}
 
-    return results;
 }
 
-double IKSVM::evalDecisionFunction(std::size_t indx, const std::vector<double> & x)
+IKSVM::Evaluator IKSVM::getBestEvaluator()
 {
-    double value = decision_values_b_[indx];
-    //tady pujde sse
-    int num_steps = approx_count_ - 1;
-    for ( size_t i = 0; i < x.size(); ++i )
+#if NOCR_IKSVM_AVX2
+    __builtin_cpu_init();
+    if ( __builtin_cpu_supports("avx2") )
     {
-        // double tmp1 =  approximated_functions_[i].getValueAt(x[i]);
-        // jsem se presune kod z ApproxFunction::compute
-        double step_size, min_sample;
-        std::tie(step_size, min_sample) = decision_function_info_[indx * features_dim_ + i];
+        return Evaluator::avx2;
+    }
+#endif
+#if defined(__SSE2__)
+    return Evaluator::sse2;
+#else
+    return Evaluator::scalar;
+#endif
+}
 
-        double f_interpolation = (x[i] - min_sample)/step_size;
+void IKSVM::setEvaluator( Evaluator evaluator )
+{
+    // model loaded from binary file has float tables only
+    if ( evaluator == Evaluator::reference && decision_function_.empty() )
+    {
+        evaluator = Evaluator::scalar;
+    }
+    evaluator_ = std::min( evaluator, getBestEvaluator() );
+}
 
-        int left = std::floor(f_interpolation);
-        int right = left + 1;
+std::size_t IKSVM::getBlockCount() const
+{
+    std::size_t number_subproblems = nr_class_ * (nr_class_ - 1) / 2;
+    return (number_subproblems + k_block_size - 1) / k_block_size;
+}
 
-        left = std::min(left, num_steps);
-        left = left > 0 ? left : 0;
-        right = std::min(right, num_steps);
-        right = right > 0 ? right : 0;
+void IKSVM::buildBlockTables()
+{
+    int number_subproblems = nr_class_ * (nr_class_ - 1) / 2;
+    std::size_t values_stride = 2 * approx_count_;
+    std::size_t info_size = getBlockCount() * features_dim_ * 2 * k_block_size;
+    std::size_t values_size = getBlockCount() * features_dim_ * k_block_size * values_stride;
 
-        std::size_t dec_fn_indx = (indx * features_dim_ + i) * approx_count_;
-        double alpha = f_interpolation - left;
-        double f_left = decision_function_[dec_fn_indx + left];
-        double f_right = decision_function_[dec_fn_indx + right];
+    // padding classifiers have zero step and values, so they add nothing
+    auto storage = std::make_shared< std::vector<float> >(info_size + values_size, 0);
+    float *block_info = storage->data();
+    float *block_values = storage->data() + info_size;
 
-        value += ( 1 - alpha ) * f_left + alpha * f_right;
+    for (int p = 0; p < number_subproblems; ++p)
+    {
+        std::size_t b = p / k_block_size;
+        int lane = p % k_block_size;
+        for (int i = 0; i < features_dim_; ++i)
+        {
+            std::size_t feature_block = b * features_dim_ + i;
+            double step_size, min_sample;
+            std::tie(step_size, min_sample) = decision_function_info_[p * features_dim_ + i];
+
+            float *info = &block_info[feature_block * 2 * k_block_size];
+            info[lane] = step_size != 0 ? 1 / step_size : 0;
+            info[k_block_size + lane] = min_sample;
+
+            float *values = &block_values[(feature_block * k_block_size + lane) * values_stride];
+            const double *function = &decision_function_[(p * features_dim_ + i) * approx_count_];
+            for (int k = 0; k < approx_count_; ++k)
+            {
+                // difference of the last value is zero, position is clamped to it
+                values[2 * k] = function[k];
+                values[2 * k + 1] = k + 1 < approx_count_ ? function[k + 1] - function[k] : 0;
+            }
+        }
     }
 
-    return value;
+    block_storage_ = storage;
+    block_info_ = block_info;
+    block_values_ = block_values;
+    quantization_ = IKSVMQuantization::none;
+    block_scales_ = nullptr;
+    block_quantized_ = nullptr;
+}
+
+void IKSVM::quantizeBlockTables( IKSVMQuantization quantization )
+{
+    if ( quantization == quantization_ )
+    {
+        return;
+    }
+    NOCR_ASSERT( quantization_ == IKSVMQuantization::none, "iksvm is already quantized" );
+
+    std::size_t num_blocks = getBlockCount();
+    std::size_t info_size = num_blocks * features_dim_ * 2 * k_block_size;
+    std::size_t scales_size = num_blocks * 2 * k_block_size;
+    std::size_t quantized_bytes = num_blocks * features_dim_ * k_block_size 
+        * (approx_count_ + 1) * quantizedValueSize( quantization ) + k_quantized_padding;
+
+    // float storage keeps alignment of all tables
+    auto storage = std::make_shared< std::vector<float> >(info_size + scales_size 
+            + (quantized_bytes + sizeof(float) - 1) / sizeof(float), 0);
+    float *block_info = storage->data();
+    float *block_scales = block_info + info_size;
+    void *block_quantized = block_scales + scales_size;
+    std::copy(block_info_, block_info_ + info_size, block_info);
+
+    if (quantization == IKSVMQuantization::int16)
+    {
+        quantizeValues(block_values_, num_blocks, features_dim_, approx_count_, 
+                block_scales, static_cast<std::int16_t *>(block_quantized));
+    }
+    else
+    {
+        quantizeValues(block_values_, num_blocks, features_dim_, approx_count_, 
+                block_scales, static_cast<std::int8_t *>(block_quantized));
+    }
+
+    block_storage_ = storage;
+    block_info_ = block_info;
+    block_values_ = nullptr;
+    quantization_ = quantization;
+    block_scales_ = block_scales;
+    block_quantized_ = block_quantized;
+}
+
+void IKSVM::evalDecisionFunctions(const std::vector<double> & x, 
+        IKSVMWorkspace & workspace) const
+{
+    std::size_t count = x.size() / features_dim_;
+    std::size_t number_subproblems = decision_values_b_.size();
+    std::vector<double> &decision_values = workspace.decision_values_;
+    std::vector<double> &block_sums = workspace.block_sums_;
+    decision_values.resize(count * number_subproblems);
+
+    if (evaluator_ == Evaluator::reference)
+    {
+        for (std::size_t k = 0; k < count; ++k)
+        {
+            for (std::size_t p = 0; p < number_subproblems; ++p)
+            {
+                decision_values[k * number_subproblems + p] 
+                    = evalDecisionFunction(p, x, k * features_dim_);
+            }
+        }
+        return;
+    }
+
+    std::size_t num_blocks = getBlockCount();
+    // sums of padding classifiers don't fit to decision_values
+    std::size_t padded_subproblems = num_blocks * k_block_size;
+    block_sums.resize(count * padded_subproblems);
+
+    if (quantization_ != IKSVMQuantization::none)
+    {
+        QuantizedTables tables{ block_info_, block_quantized_, features_dim_, approx_count_, 
+            num_blocks };
+        if (quantization_ == IKSVMQuantization::int16)
+        {
+            evalQuantizedBlocks<std::int16_t>(evaluator_, tables, x.data(), count, 
+                    block_sums.data());
+        }
+        else
+        {
+            evalQuantizedBlocks<std::int8_t>(evaluator_, tables, x.data(), count, 
+                    block_sums.data());
+        }
+
+        for (std::size_t k = 0; k < count; ++k)
+        {
+            for (std::size_t p = 0; p < number_subproblems; ++p)
+            {
+                const float *scales = &block_scales_[p / k_block_size * 2 * k_block_size];
+                int lane = p % k_block_size;
+                decision_values[k * number_subproblems + p] = decision_values_b_[p] 
+                    + scales[k_block_size + lane] 
+                    + scales[lane] * block_sums[k * padded_subproblems + p];
+            }
+        }
+        return;
+    }
+
+    BlockTables tables{ block_info_, block_values_, features_dim_, approx_count_, 
+        num_blocks };
+    switch (evaluator_)
+    {
+#if NOCR_IKSVM_AVX2
+        case Evaluator::avx2:
+            evalBlocksAvx2(tables, x.data(), count, block_sums.data());
+            break;
+#endif
+#if defined(__SSE2__)
+        case Evaluator::sse2:
+            evalBlocksSse2(tables, x.data(), count, block_sums.data());
+            break;
+#endif
+        default:
+            evalBlocksScalar(tables, x.data(), count, block_sums.data());
+            break;
+    }
+
+    for (std::size_t k = 0; k < count; ++k)
+    {
+        for (std::size_t p = 0; p < number_subproblems; ++p)
+        {
+            decision_values[k * number_subproblems + p] 
+                = decision_values_b_[p] + block_sums[k * padded_subproblems + p];
+        }
+    }
+}
+
+double IKSVM::evalOneDecisionFunction(std::size_t indx, const std::vector<double> & x, 
+        std::size_t offset) const
+{
+    if (evaluator_ == Evaluator::reference)
+    {
+        return evalDecisionFunction(indx, x, offset);
+    }
+
+    if (quantization_ != IKSVMQuantization::none)
+    {
+        QuantizedTables tables{ block_info_, block_quantized_, features_dim_, approx_count_, 
+            getBlockCount() };
+        double sum = quantization_ == IKSVMQuantization::int16 
+            ? evalQuantizedLane<std::int16_t>(tables, indx, &x[offset])
+            : evalQuantizedLane<std::int8_t>(tables, indx, &x[offset]);
+
+        const float *scales = &block_scales_[indx / k_block_size * 2 * k_block_size];
+        int lane = indx % k_block_size;
+        return decision_values_b_[indx] + scales[k_block_size + lane] + scales[lane] * sum;
+    }
+
+    BlockTables tables{ block_info_, block_values_, features_dim_, approx_count_, 
+        getBlockCount() };
+    return decision_values_b_[indx] + evalLane(tables, indx, &x[offset]);
+}
+
+double IKSVM::predictWithVoting(const std::vector<double> & x, std::size_t offset, 
+        SvmVoting voting, IKSVMWorkspace & workspace) const
+{
+    int winner = svmVote(nr_class_, voting, [this, &x, offset] (int, int, int p)
+            {
+                return evalOneDecisionFunction(p, x, offset);
+            }, workspace.vote_buffers_);
+    return labels_[winner];
+}
+
+void IKSVM::saveBinary( const std::string &file_name )
+{
+    std::ofstream ofs( file_name, std::ios::binary );
+    if ( !ofs )
+    {
+        throw ActionError( "saving to " + file_name );
+    }
+
+    BinaryHeader header;
+    std::memcpy( header.magic, k_binary_magic, sizeof(k_binary_magic) );
+    header.version = k_binary_version;
+    header.byte_order = k_byte_order;
+    header.block_size = k_block_size;
+    header.nr_class = nr_class_;
+    header.features_dim = features_dim_;
+    header.approx_count = approx_count_;
+    header.quantization = static_cast<std::int32_t>( quantization_ );
+    header.reserved = 0;
+    BinaryLayout layout( header );
+
+    auto writeSection = [&ofs] ( std::size_t offset, const void *data, std::size_t bytes )
+    {
+        // zero padding up to aligned offset
+        std::size_t position = ofs.tellp();
+        std::vector<char> padding( offset - position, 0 );
+        ofs.write( padding.data(), padding.size() );
+        ofs.write( static_cast<const char *>( data ), bytes );
+    };
+
+    std::size_t info_size = getBlockCount() * features_dim_ * 2 * k_block_size;
+    writeSection( 0, &header, sizeof(header) );
+    writeSection( layout.prob_A, prob_A_.data(), prob_A_.size() * sizeof(double) );
+    writeSection( layout.prob_B, prob_B_.data(), prob_B_.size() * sizeof(double) );
+    writeSection( layout.labels, labels_.data(), labels_.size() * sizeof(double) );
+    writeSection( layout.b, decision_values_b_.data(), decision_values_b_.size() * sizeof(double) );
+    writeSection( layout.block_info, block_info_, info_size * sizeof(float) );
+    if ( quantization_ != IKSVMQuantization::none )
+    {
+        writeSection( layout.block_scales, block_scales_, 
+                getBlockCount() * 2 * k_block_size * sizeof(float) );
+        writeSection( layout.block_values, block_quantized_, 
+                ( layout.end - layout.block_values ) );
+    }
+    else
+    {
+        writeSection( layout.block_values, block_values_, 
+                ( layout.end - layout.block_values ) );
+    }
+
+    if ( !ofs )
+    {
+        throw ActionError( "saving to " + file_name );
+    }
+}
+
+void IKSVM::loadBinary( const std::string &file_name )
+{
+    std::size_t size;
+    std::shared_ptr<const void> mapping = mapFile( file_name, size );
+    const char *data = static_cast<const char *>( mapping.get() );
+
+    BinaryHeader header;
+    if ( size < sizeof(header) )
+    {
+        throw BadFileFormatting( file_name + " is truncated" );
+    }
+    std::memcpy( &header, data, sizeof(header) );
+
+    if ( header.version < 1 || header.version > k_binary_version 
+            || header.byte_order != k_byte_order || header.block_size != k_block_size )
+    {
+        throw BadFileFormatting( file_name + " has unsupported version of iksvm binary format" );
+    }
+
+    if ( header.nr_class < 2 || header.features_dim <= 0 || header.approx_count <= 0 
+            || header.quantization < 0 
+            || header.quantization > static_cast<std::int32_t>( IKSVMQuantization::int8 ) )
+    {
+        throw BadFileFormatting( file_name + " has invalid dimensions" );
+    }
+
+    BinaryLayout layout( header );
+    if ( size < layout.end )
+    {
+        throw BadFileFormatting( file_name + " is truncated" );
+    }
+
+    nr_class_ = header.nr_class;
+    features_dim_ = header.features_dim;
+    approx_count_ = header.approx_count;
+
+    std::size_t number_subproblems = nr_class_ * (nr_class_ - 1) / 2;
+    auto readDoubles = [data] ( std::size_t offset, std::size_t count )
+    {
+        const double *first = reinterpret_cast<const double *>( data + offset );
+        return std::vector<double>( first, first + count );
+    };
+    prob_A_ = readDoubles( layout.prob_A, number_subproblems );
+    prob_B_ = readDoubles( layout.prob_B, number_subproblems );
+    labels_ = readDoubles( layout.labels, nr_class_ );
+    decision_values_b_ = readDoubles( layout.b, number_subproblems );
+
+    // tables are used in place
+    decision_function_.clear();
+    decision_function_info_.clear();
+    block_storage_ = mapping;
+    block_info_ = reinterpret_cast<const float *>( data + layout.block_info );
+    quantization_ = static_cast<IKSVMQuantization>( header.quantization );
+    if ( quantization_ != IKSVMQuantization::none )
+    {
+        block_values_ = nullptr;
+        block_scales_ = reinterpret_cast<const float *>( data + layout.block_scales );
+        block_quantized_ = data + layout.block_values;
+    }
+    else
+    {
+        block_values_ = reinterpret_cast<const float *>( data + layout.block_values );
+        block_scales_ = nullptr;
+        block_quantized_ = nullptr;
+    }
+    setEvaluator( evaluator_ );
+}
+
+// ====================predicting =======================================
+//
+
+void IKSVMWorkspace::prepareProbability( int nr_class )
+{
+    std::size_t size = nr_class * nr_class;
+    if ( pairwise_prob_.size() == size )
+    {
+        return;
+    }
+
+    pairwise_prob_.assign( size, 0 );
+    q_.assign( size, 0 );
+    qp_.assign( nr_class, 0 );
+    pairwise_rows_.resize( nr_class );
+    q_rows_.resize( nr_class );
+    for ( int i = 0; i < nr_class; ++i )
+    {
+        pairwise_rows_[i] = &pairwise_prob_[i * nr_class];
+        q_rows_[i] = &q_[i * nr_class];
+    }
+}
+
+double IKSVM::predict( const std::vector<double> &x, SvmVoting voting ) const
+{
+    IKSVMWorkspace workspace;
+    return predict( x, workspace, voting );
+}
+
+double IKSVM::predict( const std::vector<double> &x, IKSVMWorkspace &workspace, 
+        SvmVoting voting ) const
+{
+    if ( voting != SvmVoting::all )
+    {
+        return predictWithVoting(x, 0, voting, workspace);
+    }
+
+    evalDecisionFunctions(x, workspace);
+    return labels_[ voteAll( workspace.decision_values_.data(), workspace ) ];
+}
+         
+std::vector<double> IKSVM::predictMultiple(const std::vector<double> &x, SvmVoting voting) const
+{
+    IKSVMWorkspace workspace;
+    std::vector<double> results;
+    predictMultiple(x, workspace, results, voting);
+    return results;
+}
+
+void IKSVM::predictMultiple(const std::vector<double> &x, IKSVMWorkspace &workspace,
+        std::vector<double> &labels, SvmVoting voting) const
+{
+    std::size_t count = x.size() / features_dim_;
+    labels.resize(count);
+    if ( voting != SvmVoting::all )
+    {
+        for (std::size_t k = 0; k < count; ++k)
+        {
+            labels[k] = predictWithVoting(x, k * features_dim_, voting, workspace);
+        }
+        return;
+    }
+
+    evalDecisionFunctions(x, workspace);
+    std::size_t num_classifiers = nr_class_ * (nr_class_ - 1 ) / 2;
+    for (std::size_t k = 0; k < count; ++k)
+    {
+        labels[k] = labels_[ voteAll( &workspace.decision_values_[k * num_classifiers], 
+                workspace ) ];
+    }
+}
+
+int IKSVM::voteAll( const double *decision_values, IKSVMWorkspace &workspace ) const
+{
+    std::vector<int> &votes = workspace.vote_buffers_.votes;
+    votes.assign( nr_class_, 0 );
+    int p = 0;
+    for ( int i = 0; i < nr_class_; ++i ) 
+    {
+        for ( int j = i + 1; j < nr_class_; ++j )
+        {
+            if ( decision_values[p] > 0 )
+            {
+                votes[i] += 1;
+            }
+            else 
+            {
+                votes[j] += 1;
+            }
+            ++p;
+        }
+    }
+
+    int max_idx = 0;
+    for ( int i = 1; i < nr_class_; ++i ) 
+    {
+        if ( votes[max_idx] < votes[i] )
+        {
+            max_idx = i;
+        }
+    }
+    return max_idx;
 }
 
-double IKSVM::evalDecisionFunction(std::size_t indx, const std::vector<double> & x, std::size_t offset)
+double IKSVM::evalDecisionFunction(std::size_t indx, const std::vector<double> & x, 
+        std::size_t offset) const
 {
     double value = decision_values_b_[indx];
     //tady pujde sse
@@ -928,19 +1925,12 @@ double IKSVM::evalDecisionFunction(std::size_t indx, const std::vector<double> &
     return value;
 }
 
-
-std::pair<double, std::vector<double> > IKSVM::predictProbability
-                                        ( const std::vector<double> &x )
+double IKSVM::computeProbability( const double *decision_values, IKSVMWorkspace &workspace,
+        double *prob_estimates ) const
 {
-    double **pairwise_prob = new double*[nr_class_];
-    for ( int i = 0; i < nr_class_; ++i )
-    {
-        pairwise_prob[i] = new double[nr_class_];
-    }
-
-    vector<double> decision_values; 
-    computeDecisionsValue( x, decision_values ); 
-    static double min_prob = 1e-7;
+    const double min_prob = 1e-7;
+    workspace.prepareProbability( nr_class_ );
+    double **pairwise_prob = workspace.pairwise_rows_.data();
     int p = 0;
     for ( int i = 0; i < nr_class_; ++i )
     {
@@ -955,70 +1945,51 @@ std::pair<double, std::vector<double> > IKSVM::predictProbability
         }
     }
 
-    std::vector<double> prob_estimates( nr_class_, 0 );
-    multiclass_probability( nr_class_, pairwise_prob, prob_estimates.data() ); 
-    auto max_it = std::max_element( prob_estimates.begin(), prob_estimates.end() );
-    double label = labels_[ max_it - prob_estimates.begin() ];
-    for ( int i = 0; i < nr_class_; ++i )
-    {
-        delete [] pairwise_prob[i];
-    }
-    delete [] pairwise_prob;
+    multiclass_probability_buffers( nr_class_, pairwise_prob, prob_estimates, 
+            workspace.q_rows_.data(), workspace.qp_.data() ); 
+    auto max_it = std::max_element( prob_estimates, prob_estimates + nr_class_ );
+    return labels_[ max_it - prob_estimates ];
+}
+
+std::pair<double, std::vector<double> > IKSVM::predictProbability
+                                        ( const std::vector<double> &x ) const
+{
+    IKSVMWorkspace workspace;
+    std::vector<double> prob_estimates;
+    double label = predictProbability( x, workspace, prob_estimates );
     return std::make_pair( label, prob_estimates );
 }
 
+double IKSVM::predictProbability( const std::vector<double> &x, IKSVMWorkspace &workspace,
+        std::vector<double> &prob_estimates ) const
+{
+    evalDecisionFunctions( x, workspace ); 
+    prob_estimates.resize( nr_class_ );
+    return computeProbability( workspace.decision_values_.data(), workspace, 
+            prob_estimates.data() );
+}
 
 std::pair< std::vector<double>, std::vector<double> > IKSVM::predictProbabilityMultiple
-                                        ( const std::vector<double> &x )
+                                        ( const std::vector<double> &x ) const
 {
-    double **pairwise_prob = new double*[nr_class_];
-    for ( int i = 0; i < nr_class_; ++i )
-    {
-        pairwise_prob[i] = new double[nr_class_];
-    }
+    IKSVMWorkspace workspace;
+    std::vector<double> results, prob_estimates;
+    predictProbabilityMultiple( x, workspace, results, prob_estimates );
+    return std::make_pair( results, prob_estimates );
+}
 
+void IKSVM::predictProbabilityMultiple( const std::vector<double> &x, IKSVMWorkspace &workspace,
+        std::vector<double> &labels, std::vector<double> &prob_estimates ) const
+{
     std::size_t count = x.size()/features_dim_;
-    vector<double> decision_values; 
-    computeDecisionsValueMult( x, decision_values ); 
-     
-    std::vector<double> prob_estimates( count * nr_class_, 0 );
     std::size_t num_classifiers = nr_class_ *(nr_class_ - 1)/2;
-
-    std::vector<double> results(count, 0);
-
-    static double min_prob = 1e-7;
+    evalDecisionFunctions( x, workspace ); 
+     
+    labels.resize( count );
+    prob_estimates.resize( count * nr_class_ );
     for (std::size_t k = 0; k < count; ++k)
     {
-        int p = 0;
-        for ( int i = 0; i < nr_class_; ++i )
-        {
-            for ( int j = i + 1; j < nr_class_; ++j )
-            {
-                double sigmoid_predict_value = sigmoid_predict(decision_values[k * num_classifiers + p], 
-                        prob_A_[p], prob_B_[p] );
-                double prob = std::min( std::max(sigmoid_predict_value, min_prob), 1 - min_prob );
-                pairwise_prob[i][j] = prob;
-                pairwise_prob[j][i] = 1 - prob;
-                ++p;
-            }
-        }
-
-        int indx = k * nr_class_;
-        multiclass_probability( nr_class_, pairwise_prob, &prob_estimates[indx]);
-        auto it = prob_estimates.begin() + indx;
-
-        auto max_it = std::max_element( it, it + nr_class_);
-        results[k] = labels_[ max_it - it];
-    }
-
-
-    for ( int i = 0; i < nr_class_; ++i )
-    {
-        delete [] pairwise_prob[i];
+        labels[k] = computeProbability( &workspace.decision_values_[k * num_classifiers], 
+                workspace, &prob_estimates[k * nr_class_] );
     }
-    delete [] pairwise_prob;
-
-    return std::make_pair( results, prob_estimates );
 }
-
-
@@ -18,6 +18,18 @@
 
 using namespace std;
 
+namespace
+{
+
+// ocr can be shared by threads, every thread reuses its own buffers
+IKSVMWorkspace & threadWorkspace()
+{
+    static thread_local IKSVMWorkspace workspace;
+    return workspace;
+}
+
+}
+
 
 char MyOCR::translate( Component &c, std::vector<double> &probabilities )
 {
@@ -26,8 +38,7 @@ char MyOCR::translate( Component &c, std::vector<double> &probabilities )
     // float index_letter = svm_.predictProbabilities( features, probabilities ); 
 
     vector<double> tmp( features.begin(), features.end() );
-    double index_letter; 
-    std::tie(index_letter,probabilities) = iksvm_.predictProbability( tmp );
+    double index_letter = iksvm_.predictProbability( tmp, threadWorkspace(), probabilities );
 
     return alpha[index_letter];
 }
@@ -45,7 +56,7 @@ std::vector<char> MyOCR::translate( const std::vector<std::shared_ptr<Component>
     }
 
     std::vector<double> labels;
-    std::tie(labels, probabilities) = iksvm_.predictProbabilityMultiple(features);
+    iksvm_.predictProbabilityMultiple(features, threadWorkspace(), labels, probabilities);
 
     std::vector<char> characters;
     characters.reserve(labels.size());
@@ -71,7 +82,7 @@ std::vector<char> MyOCR::translate( std::vector<Component> & components,
     }
 
     std::vector<double> labels;
-    std::tie(labels, probabilities) = iksvm_.predictProbabilityMultiple(features);
+    iksvm_.predictProbabilityMultiple(features, threadWorkspace(), labels, probabilities);
 
     std::vector<char> characters;
     characters.reserve(labels.size());
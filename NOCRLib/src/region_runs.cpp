@@ -0,0 +1,314 @@
+/*
+ * Implementation of methods and classes declared in region_runs.h
+ *
+ * Compiler: g++ 4.8.3
+ */
+#include "../include/nocrlib/region_runs.h"
+
+#include <opencv2/core/core.hpp>
+
+#include <algorithm>
+#include <numeric>
+#include <limits>
+#include <cstdlib>
+
+using namespace std;
+
+namespace
+{
+    // directions of cv::findContours: right, up-right, up, ..., down-right
+    const int k_dx[] = { 1, 1, 0, -1, -1, -1, 0, 1 };
+    const int k_dy[] = { 0, -1, -1, -1, 0, 1, 1, 1 };
+
+    long long cross( cv::Point o, cv::Point a, cv::Point b )
+    {
+        return (long long) ( a.x - o.x ) * ( b.y - o.y )
+            - (long long) ( a.y - o.y ) * ( b.x - o.x );
+    }
+}
+
+void RegionRuns::build( const vector<cv::Point> &points )
+{
+    runs_.clear();
+    rows_ = cols_ = 0;
+    if ( points.empty() )
+    {
+        return;
+    }
+
+    int x_min = numeric_limits<int>::max(), x_max = numeric_limits<int>::min();
+    int y_min = numeric_limits<int>::max(), y_max = numeric_limits<int>::min();
+    for ( const cv::Point &p : points )
+    {
+        x_min = std::min( x_min, p.x );
+        x_max = std::max( x_max, p.x );
+        y_min = std::min( y_min, p.y );
+        y_max = std::max( y_max, p.y );
+    }
+
+    // one pixel of background on every side
+    cols_ = x_max - x_min + 3;
+    rows_ = y_max - y_min + 3;
+
+    // counting sort of pixels by row
+    row_offsets_.assign( rows_ + 1, 0 );
+    for ( const cv::Point &p : points )
+    {
+        ++row_offsets_[ p.y - y_min + 2 ];
+    }
+    std::partial_sum( row_offsets_.begin(), row_offsets_.end(), row_offsets_.begin() );
+
+    row_runs_.assign( row_offsets_.begin(), row_offsets_.end() );
+    row_xs_.resize( points.size() );
+    for ( const cv::Point &p : points )
+    {
+        row_xs_[ row_runs_[ p.y - y_min + 1 ]++ ] = p.x - x_min + 1;
+    }
+
+    for ( int y = 0; y < rows_; ++y )
+    {
+        row_runs_[y] = runs_.size();
+        auto begin = row_xs_.begin() + row_offsets_[y];
+        auto end = row_xs_.begin() + row_offsets_[y + 1];
+        std::sort( begin, end );
+
+        for ( auto it = begin; it != end; ++it )
+        {
+            if ( (int) runs_.size() > row_runs_[y] && runs_.back().end == *it )
+            {
+                ++runs_.back().end;
+            }
+            else
+            {
+                runs_.push_back( Run{ *it, *it + 1 } );
+            }
+        }
+    }
+    row_runs_[rows_] = runs_.size();
+}
+
+size_t RegionRuns::getHoleArea()
+{
+    background_.clear();
+    background_rows_.resize( rows_ + 1 );
+    for ( int y = 0; y < rows_; ++y )
+    {
+        background_rows_[y] = background_.size();
+        int start = 0;
+        for ( int i = row_runs_[y]; i < row_runs_[y + 1]; ++i )
+        {
+            if ( runs_[i].begin > start )
+            {
+                background_.push_back( Run{ start, runs_[i].begin } );
+            }
+            start = runs_[i].end;
+        }
+
+        if ( start < cols_ )
+        {
+            background_.push_back( Run{ start, cols_ } );
+        }
+    }
+    background_rows_[rows_] = background_.size();
+
+    // last element represents background outside the bounding box
+    int outside = background_.size();
+    parents_.resize( outside + 1 );
+    std::iota( parents_.begin(), parents_.end(), 0 );
+
+    for ( int y = 0; y < rows_; ++y )
+    {
+        for ( int i = background_rows_[y]; i < background_rows_[y + 1]; ++i )
+        {
+            if ( y == 0 || y == rows_ - 1 || background_[i].begin == 0
+                    || background_[i].end == cols_ )
+            {
+                parents_[ find(i) ] = find( outside );
+            }
+        }
+
+        if ( y == 0 )
+        {
+            continue;
+        }
+
+        // runs of two neighbouring rows are 4-connected, if they share a column
+        int i = background_rows_[y], j = background_rows_[y - 1];
+        while ( i < background_rows_[y + 1] && j < background_rows_[y] )
+        {
+            const Run &a = background_[i];
+            const Run &b = background_[j];
+            if ( a.begin < b.end && b.begin < a.end )
+            {
+                parents_[ find(i) ] = find(j);
+            }
+
+            if ( a.end < b.end )
+            {
+                ++i;
+            }
+            else
+            {
+                ++j;
+            }
+        }
+    }
+
+    size_t hole_area = 0;
+    int outside_root = find( outside );
+    for ( int i = 0; i < outside; ++i )
+    {
+        if ( find(i) != outside_root )
+        {
+            hole_area += background_[i].end - background_[i].begin;
+        }
+    }
+
+    return hole_area;
+}
+
+size_t RegionRuns::getConvexHullArea()
+{
+    // pixels on the ends of rows are sufficient for the hull,
+    // they are sorted by row and column
+    extremes_.clear();
+    for ( int y = 0; y < rows_; ++y )
+    {
+        if ( row_runs_[y] == row_runs_[y + 1] )
+        {
+            continue;
+        }
+
+        int left = runs_[ row_runs_[y] ].begin;
+        int right = runs_[ row_runs_[y + 1] - 1 ].end - 1;
+        extremes_.emplace_back( left, y );
+        if ( right != left )
+        {
+            extremes_.emplace_back( right, y );
+        }
+    }
+
+    int n = extremes_.size();
+    if ( n < 3 )
+    {
+        return 0;
+    }
+
+    // monotone chain
+    hull_.resize( 2 * n );
+    int k = 0;
+    for ( int i = 0; i < n; ++i )
+    {
+        while ( k >= 2 && cross( hull_[k - 2], hull_[k - 1], extremes_[i] ) <= 0 )
+        {
+            --k;
+        }
+        hull_[k++] = extremes_[i];
+    }
+
+    for ( int i = n - 2, lower = k + 1; i >= 0; --i )
+    {
+        while ( k >= lower && cross( hull_[k - 2], hull_[k - 1], extremes_[i] ) <= 0 )
+        {
+            --k;
+        }
+        hull_[k++] = extremes_[i];
+    }
+
+    // last point is the same as the first one
+    long long double_area = 0;
+    for ( int i = 0; i + 1 < k; ++i )
+    {
+        double_area += (long long) hull_[i].x * hull_[i + 1].y
+            - (long long) hull_[i + 1].x * hull_[i].y;
+    }
+
+    return std::abs( double_area ) / 2;
+}
+
+void RegionRuns::getOuterContour( vector<cv::Point> &contour ) const
+{
+    contour.clear();
+
+    int first_row = 0;
+    while ( first_row < rows_ && row_runs_[first_row] == row_runs_[first_row + 1] )
+    {
+        ++first_row;
+    }
+
+    if ( first_row == rows_ )
+    {
+        return;
+    }
+
+    // the same border following as in cv::findContours with CHAIN_APPROX_NONE
+    cv::Point start( runs_[ row_runs_[first_row] ].begin, first_row );
+    cv::Point second;
+    int s = 4, s_end = 4;
+    do
+    {
+        s = ( s - 1 ) & 7;
+        second = start + cv::Point( k_dx[s], k_dy[s] );
+        if ( isInside( second ) )
+        {
+            break;
+        }
+    }
+    while ( s != s_end );
+
+    if ( s == s_end )
+    {
+        // single pixel region
+        contour.push_back( start );
+        return;
+    }
+
+    cv::Point current = start;
+    for ( ;; )
+    {
+        cv::Point next;
+        do
+        {
+            s = ( s + 1 ) & 7;
+            next = current + cv::Point( k_dx[s], k_dy[s] );
+        }
+        while ( !isInside( next ) );
+
+        contour.push_back( current );
+        if ( next == start && current == second )
+        {
+            break;
+        }
+
+        current = next;
+        s = ( s + 4 ) & 7;
+    }
+}
+
+bool RegionRuns::isInside( cv::Point p ) const
+{
+    if ( p.y < 0 || p.y >= rows_ )
+    {
+        return false;
+    }
+
+    auto begin = runs_.begin() + row_runs_[p.y];
+    auto end = runs_.begin() + row_runs_[p.y + 1];
+    auto it = std::upper_bound( begin, end, p.x,
+            [] ( int x, const Run &run )
+            {
+                return x < run.begin;
+            });
+
+    return it != begin && p.x < (it - 1)->end;
+}
+
+int RegionRuns::find( int run )
+{
+    while ( parents_[run] != run )
+    {
+        parents_[run] = parents_[ parents_[run] ];
+        run = parents_[run];
+    }
+    return run;
+}
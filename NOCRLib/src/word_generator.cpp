@@ -625,6 +625,7 @@ vector<int> WordGenerator::reconstruct( int start_row, int start_col )
 // ================== processing dictionary tree =================
 std::vector<TranslatedWord> WordGenerator::process( const Dictionary &dictionary )
 {
+    truncated_ = false;
     if ( letters_.empty() )
     {
         return std::vector<TranslatedWord>();
@@ -647,6 +648,11 @@ std::vector<TranslatedWord> WordGenerator::process( const Dictionary &dictionary
     auto root_children = dictionary.getRoot()->getChildren();
     for ( const auto &p : root_children ) 
     {
+        if ( isExpired() )
+        {
+            break;
+        }
+
         --current_depth_;
         word.push_back( p.first );
         traverse( p.second, word );
@@ -801,6 +807,12 @@ void WordGenerator::traverse( TrieNode *node, std::string &word )
     auto children  = node->getChildren();
     for ( const auto &pair : children ) 
     {
+        // words already detected are kept
+        if ( isExpired() )
+        {
+            return;
+        }
+
         current_depth_--;
        
         word.push_back( pair.first ); 
@@ -810,6 +822,12 @@ void WordGenerator::traverse( TrieNode *node, std::string &word )
     }
 }
 
+bool WordGenerator::isExpired()
+{
+    truncated_ = truncated_ || deadline_.expired();
+    return truncated_;
+}
+
 void WordGenerator::updateTables( char current_letter )
 {
     // inicialization that letter_[i] is the last letter of current word
@@ -18,6 +18,7 @@
 #include <algorithm>
 #include <exception>
 #include <ostream>
+#include <sstream>
 
 #include <nocrlib/structures.h>
 #include <nocrlib/drawer.h>
@@ -25,6 +26,11 @@
 #include <nocrlib/ocr.h>
 #include <nocrlib/word_generator.h>
 #include <nocrlib/text_recognition.h>
+#include <nocrlib/er_coarse_to_fine.h>
+#include <nocrlib/roi_text_recognition.h>
+#include <nocrlib/exception.h>
+#include <nocrlib/deadline.h>
+#include <nocrlib/video_text_session.h>
 
 #include "xml_creator.h"
 #include "recorder_interface.h"
@@ -36,12 +42,137 @@
 using namespace std;
 using namespace cv;
 
+/**
+ * @brief recognizes text in all input images and records found words
+ */
+template <typename EXTRACTION>
+void recognizeImages( TextRecognition<EXTRACTION, AbstractOCR> &image_reader,
+        const vector<string> &input, const Dictionary &dictionary,
+        RecorderInterface &recorder, int time_budget )
+{
+    for ( const std::string &file_path : input )
+    {
+        // budget of every image starts with its loading
+        Deadline deadline;
+        if ( time_budget > 0 )
+        {
+            deadline = Deadline::after( std::chrono::milliseconds( time_budget ) );
+        }
+
+        TruncatedStages truncated;
+        vector<TranslatedWord> words = image_reader.recognize( file_path, 
+                dictionary, deadline, truncated );
+        recorder.makeRecord( file_path, words ); 
+
+        if ( truncated.any() )
+        {
+            std::cerr << file_path << " truncated:"
+                << ( truncated.extraction ? " extraction" : "" )
+                << ( truncated.ocr ? " ocr" : "" )
+                << ( truncated.word_generation ? " word-generation" : "" ) << std::endl;
+        }
+    }
+}
+
+/**
+ * @brief recognizes text only inside regions of interest of all input images
+ */
+void recognizeImagesInRois( ROITextRecognition<AbstractOCR> &roi_reader,
+        const vector<string> &input, const vector<cv::Rect> &rois,
+        const Dictionary &dictionary, RecorderInterface &recorder )
+{
+    for ( const std::string &file_path : input )
+    {
+        cv::Mat image = cv::imread( file_path, CV_LOAD_IMAGE_COLOR );
+        if ( image.empty() )
+        {
+            throw FileNotFoundException( "image at path " + 
+                    file_path + " doesn't exist" );
+        }
+
+        vector<TranslatedWord> words = roi_reader.recognize( image, rois, 
+                dictionary );
+        recorder.makeRecord( file_path, words ); 
+    }
+}
+
+/**
+ * @brief recognizes text in input images as consecutive video frames, 
+ * every frame is processed as whole first, then the sequence is processed 
+ * again with reuse of unchanged tiles and words of the second run are recorded
+ */
+void recognizeFrames( VideoTextSession<AbstractOCR> &session, 
+        const vector<string> &input, const Dictionary &dictionary,
+        RecorderInterface &recorder )
+{
+    vector<cv::Mat> frames;
+    for ( const std::string &file_path : input )
+    {
+        cv::Mat frame = cv::imread( file_path, CV_LOAD_IMAGE_COLOR );
+        if ( frame.empty() )
+        {
+            throw FileNotFoundException( "image at path " + 
+                    file_path + " doesn't exist" );
+        }
+        frames.push_back( frame );
+    }
+
+    if ( frames.empty() )
+    {
+        return;
+    }
+
+    typedef std::chrono::steady_clock Clock;
+    timeCounter<Clock, std::chrono::milliseconds> tC;
+
+    auto begin = Clock::now();
+    for ( const cv::Mat &frame : frames )
+    {
+        session.reset();
+        session.processFrame( frame, dictionary );
+    }
+    auto whole_time = tC( begin, Clock::now() ).count();
+
+    session.reset();
+    std::size_t dirty_tiles = 0, tiles = 0;
+    begin = Clock::now();
+    for ( std::size_t i = 0; i < frames.size(); ++i )
+    {
+        vector<TranslatedWord> words = session.processFrame( frames[i], dictionary );
+        dirty_tiles += session.getDirtyTiles();
+        tiles += session.getTiles();
+        recorder.makeRecord( input[i], words ); 
+    }
+    auto session_time = tC( begin, Clock::now() ).count();
+
+    std::cout << "whole frames: " << frames.size() * 1000.0 / std::max<long>( whole_time, 1 ) 
+        << " fps, reused tiles: " << frames.size() * 1000.0 / std::max<long>( session_time, 1 ) 
+        << " fps, dirty tiles " << dirty_tiles << "/" << tiles << std::endl;
+}
+
+/**
+ * @brief parses region of interest in format x,y,width,height
+ */
+bool parseRoi( const std::string &text, cv::Rect &roi )
+{
+    std::istringstream iss( text );
+    char c1, c2, c3;
+    iss >> roi.x >> c1 >> roi.y >> c2 >> roi.width >> c3 >> roi.height;
+    return iss && c1 == ',' && c2 == ',' && c3 == ',' 
+        && roi.width > 0 && roi.height > 0;
+}
+
 int main ( int argc, char** argv ) 
 {
     // ====================== setting up command line parameters ====================
     std::string output;
     std::string dict = "conf/dict";
     vector<string> input_lists;
+    vector<string> roi_args;
+    std::size_t candidate_budget = 0;
+    int time_budget = 0;
+    std::string scale_policy = "upscale";
+    int text_height = 0;
 
 
     std::string svm_ER2Phase = "conf/scaled_svmEr2_resized.xml";
@@ -55,6 +186,14 @@ int main ( int argc, char** argv )
         ("xml","enable xml output")
         ("display-words", "enable displaying of detected words")
         ("display-letters", "enable displaying of detected letters")
+        ("parallel-polarity", "process dark and bright letters on two threads")
+        ("coarse-to-fine", "extract letters only around text proposals found in downscaled image")
+        ("candidate-budget", po::value<std::size_t>(&candidate_budget), "maximal number of letter candidates per tree, 0 means unlimited")
+        ("frames", "input images are consecutive video frames, unchanged tiles are reused")
+        ("scale-policy", po::value<std::string>(&scale_policy), "resolution of detection: upscale, native or adaptive")
+        ("text-height", po::value<int>(&text_height), "height of the smallest expected text in pixels for adaptive scale policy")
+        ("time-budget", po::value<int>(&time_budget), "time budget per image in milliseconds, best words found in budget are recorded")
+        ("roi", po::value< vector<string> >(&roi_args), "recognize text only in region of interest x,y,width,height, can be repeated")
         ("svm-er-2stage", po::value<string>(&svm_ER2Phase), "specifies svm config path");
     
 
@@ -91,6 +230,36 @@ int main ( int argc, char** argv )
 
     bool display_letters = vm.count("display-letters") != 0; 
     bool display_words = vm.count("display-words") != 0;
+    bool parallel_polarity = vm.count("parallel-polarity") != 0;
+    bool coarse_to_fine = vm.count("coarse-to-fine") != 0;
+    bool frames = vm.count("frames") != 0;
+
+    ScalePolicy policy = ScalePolicy::upscale;
+    if ( scale_policy == "native" )
+    {
+        policy = ScalePolicy::native;
+    }
+    else if ( scale_policy == "adaptive" )
+    {
+        policy = ScalePolicy::adaptive;
+    }
+    else if ( scale_policy != "upscale" )
+    {
+        std::cerr << "unknown scale policy: " << scale_policy << std::endl;
+        return 1;
+    }
+
+    vector<cv::Rect> rois;
+    for ( const string &roi_arg : roi_args )
+    {
+        cv::Rect roi;
+        if ( !parseRoi( roi_arg, roi ) )
+        {
+            std::cerr << "invalid region of interest: " << roi_arg << std::endl;
+            return 1;
+        }
+        rois.push_back( roi );
+    }
 
     std::ostream *oss = &std::cout;
     if ( !output.empty() )
@@ -111,21 +280,51 @@ int main ( int argc, char** argv )
     const std::string ocr_conf = "conf/svm_dir_ocr.conf";
 
     cout << svm_ER2Phase << endl;
-    TextRecognition<ERTextDetection, AbstractOCR> image_reader;
-    image_reader.setShowingLetters( display_letters );
-    image_reader.setShowingWords( display_words );
     try 
     {
         Dictionary dictionary(dict);
-        image_reader.constructExtractionMethod( boost_ER1Phase, svm_ER2Phase);
         unique_ptr<AbstractOCR> ocr( new DirHistRBFOcr(ocr_conf) );
-        image_reader.loadOcr( ocr.get() );
-        
-        for ( const std::string &file_path : input )
+
+        if ( frames )
+        {
+            VideoTextSession<AbstractOCR> session( boost_ER1Phase, svm_ER2Phase );
+            session.getDetection().setParallelPolarity( parallel_polarity );
+            session.getDetection().getTree().setCandidateBudget( candidate_budget );
+            session.loadOcr( ocr.get() );
+            recognizeFrames( session, input, dictionary, *recorder );
+        }
+        else if ( !rois.empty() )
+        {
+            ROITextRecognition<AbstractOCR> roi_reader( boost_ER1Phase, svm_ER2Phase );
+            roi_reader.getTree().setCandidateBudget( candidate_budget );
+            roi_reader.loadOcr( ocr.get() );
+            recognizeImagesInRois( roi_reader, input, rois, dictionary, *recorder );
+        }
+        else if ( coarse_to_fine )
+        {
+            TextRecognition<ERCoarseToFineDetection, AbstractOCR> image_reader;
+            image_reader.setShowingLetters( display_letters );
+            image_reader.setShowingWords( display_words );
+            image_reader.setScalePolicy( policy );
+            image_reader.setExpectedTextHeight( text_height );
+            image_reader.constructExtractionMethod( boost_ER1Phase, svm_ER2Phase);
+            image_reader.getExtraction()->getDetection().setParallelPolarity( parallel_polarity );
+            image_reader.getExtraction()->getTree().setCandidateBudget( candidate_budget );
+            image_reader.loadOcr( ocr.get() );
+            recognizeImages( image_reader, input, dictionary, *recorder, time_budget );
+        }
+        else
         {
-            vector<TranslatedWord> words = image_reader.recognize( file_path, 
-                    dictionary );
-            recorder->makeRecord( file_path, words ); 
+            TextRecognition<ERTextDetection, AbstractOCR> image_reader;
+            image_reader.setShowingLetters( display_letters );
+            image_reader.setShowingWords( display_words );
+            image_reader.setScalePolicy( policy );
+            image_reader.setExpectedTextHeight( text_height );
+            image_reader.constructExtractionMethod( boost_ER1Phase, svm_ER2Phase);
+            image_reader.getExtraction()->setParallelPolarity( parallel_polarity );
+            image_reader.getExtraction()->getTree().setCandidateBudget( candidate_budget );
+            image_reader.loadOcr( ocr.get() );
+            recognizeImages( image_reader, input, dictionary, *recorder, time_budget );
         }
 
         recorder->save( *oss ); 